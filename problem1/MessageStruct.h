@@ -3,7 +3,7 @@
  *
  *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
  *
- *  Structure to save file chunks and partial results.
+ *  Structures to save file chunks and partial results, and to send them between the processes.
  *
  *  \author Eduardo Santos and Pedro Bastos - May 2022
  */
@@ -13,6 +13,31 @@
 #ifndef MESSAGESTRUCT_H_
 #define MESSAGESTRUCT_H_
 
+#if METRICS
+/**
+ *  \brief optional metrics of a piece of text, present only in builds that select some.
+ *
+ *  The totals add up across pieces. The word lengths also keep the words cut by the boundaries of
+ *  the piece, which are only counted once the pieces around them are merged.
+ */
+typedef struct{
+#if METRICS & METRIC_LENGTHS
+    long long lengths[METRIC_MAX_LENGTH + 1];   /* words of each length, the last bin for longer ones */
+    long long length_total;         /* chars of all the words counted in lengths */
+    long long head_length;          /* chars before the first split char, after the leading apostrophes */
+    long long tail_length;          /* chars of the word still open at the end */
+    int head_ends;                  /* 1 if a split char ends the first word inside the piece */
+    int head_zero;                  /* 1 if the char before that split char is 0 */
+#endif
+#if METRICS & METRIC_CLASSES
+    long long classes[METRIC_N_CLASSES];   /* vowels, consonants, split chars, apostrophes and other chars */
+#endif
+#if METRICS & METRIC_LINES
+    long long lines;
+#endif
+} Metrics;
+#endif
+
 /** \brief  structure */
 typedef struct{
     int file_index;
@@ -21,7 +46,86 @@ typedef struct{
     int num_vowels;
     int num_cons;
     unsigned int ch_values[NUM_BYTES + 10];
+#if METRICS
+    Metrics metrics;
+#endif
 
 } MessageStruct;
 
+/** \brief header of a chunk sent to a worker */
+typedef struct{
+    int file_index;
+    int chunk_index;
+    int n_bytes;
+} ChunkHeader;
+
+/** \brief chunk sent to a worker: the header followed by the raw UTF-8 bytes, allocated for the chunk size in use */
+typedef struct{
+    ChunkHeader header;
+    unsigned char bytes[];
+} WireChunk;
+
+/**
+ *  \brief partial results of a chunk sent back to the dispatcher.
+ *
+ *  Besides the counters of the words that lie inside the chunk, it keeps the state at both
+ *  boundaries, so that the results of consecutive chunks of a file, cut at any byte offset, can be
+ *  merged in any grouping. A chunk starts in the middle of a word when its first char is not a
+ *  split char or when it has head bytes, and ends in the middle of one when its last char is not
+ *  a split char or when it has tail bytes.
+ */
+typedef struct{
+    int file_index;
+    int chunk_index;
+    long long num_words;
+    long long num_vowels;
+    long long num_cons;
+    long long lead_apostrophes;     /* number of apostrophes before the first other char */
+    int first_class;                /* class of the first char that is not an apostrophe, -1 if none */
+    int last_class;                 /* class of the last char, an apostrophe after a split char counting as a split char */
+    int n_head_bytes;
+    int n_tail_bytes;
+    unsigned char head_bytes[3];    /* end of a char that started in the previous chunk */
+    unsigned char tail_bytes[3];    /* start of a char that continues in the next chunk */
+    long long n_bytes;              /* bytes of text the result covers */
+    double compute_time;            /* seconds the worker spent on the chunk */
+#if METRICS
+    Metrics metrics;
+#endif
+} ChunkResult;
+
+/** \brief partial results of a run of chunks without their counters: only the state at its boundaries */
+typedef struct{
+    int file_index;
+    int chunk_index;                /* first chunk of the run */
+    int n_chunks;                   /* number of consecutive chunks of the run */
+    long long lead_apostrophes;
+    signed char first_class;
+    signed char last_class;
+    unsigned char n_head_bytes;
+    unsigned char n_tail_bytes;
+    unsigned char head_bytes[3];
+    unsigned char tail_bytes[3];
+} ChunkAck;
+
+/** \brief state kept between the chars of a text while it is counted */
+typedef struct{
+    int flag;                       /* 1 once the first char was seen */
+    int value_before;               /* previous char */
+    int class_before;               /* class of the previous char */
+    int end_of_word;                /* 1 if the previous char was a split char */
+#if METRICS & METRIC_LENGTHS
+    long long word_length;          /* chars of the word in progress */
+    long long head_length;          /* chars of the first word, until a split char ends it */
+    int head_ends;                  /* 1 once a split char was seen */
+    int head_zero;                  /* 1 if the char before the first split char is 0 */
+#endif
+} WordState;
+
+/** \brief Number of bytes of a chunk on the wire */
+#define WIRE_SIZE(chunk)   ((int) sizeof(ChunkHeader) + (chunk)->header.n_bytes)
+
+/** \brief Number of bytes to allocate for a chunk of up to max_bytes */
+#define WIRE_BYTES(max_bytes)   (sizeof(ChunkHeader) + (size_t)(max_bytes))
+
 #endif
\ No newline at end of file
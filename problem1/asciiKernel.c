@@ -0,0 +1,363 @@
+/**
+ *  \file asciiKernel.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Vectorized counting kernel for pure ASCII text. Each block of 64 bytes is turned into one bit
+ *  mask per char class (AVX2 or SSE4.2, chosen at runtime) and the words are counted from the masks
+ *  with shifts and popcounts. The masks follow the same rules as processVal: an apostrophe that
+ *  follows a split char is skipped, which is the same as treating it as a split char.
+ *
+ *  Definition of the operations:
+ *     \li ascii_kernel
+ *     \li ascii_kernel_force.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "worker.h"
+#include "asciiKernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASCII_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+/** \brief bit masks of the char classes of a block of 64 bytes, bit i for byte i */
+typedef struct {
+  uint64_t vowel;
+  uint64_t cons;
+  uint64_t split;
+  uint64_t apostrophe;
+  uint64_t zero;
+} BlockMasks;
+
+/** \brief class bits of the last byte of the previous block */
+typedef struct {
+  uint64_t split;
+  uint64_t cons;
+  uint64_t zero;
+} BlockCarry;
+
+/** \brief function that fills the masks of a full block */
+typedef void (*classify_fn)(const unsigned char *bytes, BlockMasks *masks);
+
+/** \brief kernel selected for this CPU, NULL if none */
+static classify_fn classify_block = NULL;
+
+/** \brief makes the kernel be selected once, even with several threads */
+static pthread_once_t kernel_selected = PTHREAD_ONCE_INIT;
+
+/** 
+ *  \brief Fill the masks of a block byte by byte.
+ * 
+ *  \param bytes block of text.
+ *  \param n_bytes number of bytes in the block, at most 64.
+ *  \param masks masks to be filled.
+ */
+
+static void classify_scalar(const unsigned char *bytes, int n_bytes, BlockMasks *masks) {
+
+  int ch_class;
+
+  memset(masks, 0, sizeof(BlockMasks));
+
+  for (int i = 0; i < n_bytes; i++) {
+    ch_class = char_class(bytes[i]);
+    masks->vowel |= (uint64_t) ((ch_class & CLASS_VOWEL) != 0) << i;
+    masks->cons |= (uint64_t) ((ch_class & CLASS_CONSONANT) != 0) << i;
+    masks->split |= (uint64_t) ((ch_class & CLASS_SPLIT) != 0) << i;
+    masks->apostrophe |= (uint64_t) ((ch_class & CLASS_APOSTROPHE) != 0) << i;
+    masks->zero |= (uint64_t) (bytes[i] == 0) << i;
+  }
+}
+
+/** 
+ *  \brief Count the words of a block from its masks.
+ * 
+ *  \param masks masks of the block.
+ *  \param n_bytes number of bytes in the block.
+ *  \param carry class bits of the last byte of the previous block, updated to this block.
+ *  \param messageStruct structure whose counters are incremented.
+ */
+
+static void count_block(const BlockMasks *masks, int n_bytes, BlockCarry *carry, MessageStruct *messageStruct) {
+
+  /* apostrophes right after a split char, directly or through other apostrophes, act as split chars */
+  uint64_t starts = ((masks->split << 1) | carry->split) & masks->apostrophe;
+  uint64_t split = masks->split | (((masks->apostrophe + starts) ^ masks->apostrophe) & masks->apostrophe);
+
+  /* class of the previous byte */
+  uint64_t prev_split = (split << 1) | carry->split;
+  uint64_t prev_cons = (masks->cons << 1) | carry->cons;
+  uint64_t prev_zero = (masks->zero << 1) | carry->zero;
+
+  messageStruct->num_vowels += __builtin_popcountll(masks->vowel & prev_split);
+  messageStruct->num_cons += __builtin_popcountll(split & prev_cons);
+  messageStruct->num_words += __builtin_popcountll(split & ~prev_split & ~prev_zero);
+
+  carry->split = (split >> (n_bytes - 1)) & 1;
+  carry->cons = (masks->cons >> (n_bytes - 1)) & 1;
+  carry->zero = (masks->zero >> (n_bytes - 1)) & 1;
+}
+
+#ifdef ASCII_KERNEL_X86
+
+/** \brief bitmaps of each class, indexed by high nibble, for low nibbles 0-7 and 8-15 */
+static unsigned char class_bitmaps[3][2][16] __attribute__((aligned(32)));
+
+/** \brief bit of each low nibble inside a bitmap */
+static const unsigned char nibble_bits[16] __attribute__((aligned(16))) = {
+  1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+
+/** \brief class flags matching the bitmaps */
+static const int bitmap_classes[3] = { CLASS_VOWEL, CLASS_CONSONANT, CLASS_SPLIT };
+
+/** 
+ *  \brief Build the class bitmaps of the ASCII range from the char class table.
+ */
+
+static void build_bitmaps() {
+  for (int k = 0; k < 3; k++)
+    for (int ch = 0; ch < 128; ch++)
+      if (char_class(ch) & bitmap_classes[k])
+        class_bitmaps[k][(ch & 15) >> 3][ch >> 4] |= 1 << (ch & 7);
+}
+
+/** 
+ *  \brief Fill the masks of a full block with AVX2, 32 bytes at a time.
+ * 
+ *  \param bytes block of 64 bytes.
+ *  \param masks masks to be filled.
+ */
+
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *bytes, BlockMasks *masks) {
+
+  const __m256i low_mask = _mm256_set1_epi8(0x0F);
+  const __m256i bits = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) nibble_bits));
+  uint64_t result[3];
+
+  memset(masks, 0, sizeof(BlockMasks));
+  memset(result, 0, sizeof(result));
+
+  for (int half = 0; half < 2; half++) {
+
+    __m256i x = _mm256_loadu_si256((const __m256i *) (bytes + 32 * half));
+    __m256i lo = _mm256_and_si256(x, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    __m256i bit = _mm256_shuffle_epi8(bits, lo);
+    __m256i upper = _mm256_cmpgt_epi8(lo, _mm256_set1_epi8(7));
+
+    for (int k = 0; k < 3; k++) {
+      __m256i row_lo = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) class_bitmaps[k][0])), hi);
+      __m256i row_hi = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) class_bitmaps[k][1])), hi);
+      __m256i row = _mm256_blendv_epi8(row_lo, row_hi, upper);
+      __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+      result[k] |= (uint64_t) (uint32_t) _mm256_movemask_epi8(hit) << (32 * half);
+    }
+
+    masks->apostrophe |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\''))) << (32 * half);
+    masks->zero |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_setzero_si256())) << (32 * half);
+  }
+
+  masks->vowel = result[0];
+  masks->cons = result[1];
+  masks->split = result[2];
+}
+
+/** 
+ *  \brief Fill the masks of a full block with SSE4.2, 16 bytes at a time.
+ * 
+ *  \param bytes block of 64 bytes.
+ *  \param masks masks to be filled.
+ */
+
+__attribute__((target("sse4.2")))
+static void classify_sse42(const unsigned char *bytes, BlockMasks *masks) {
+
+  const __m128i low_mask = _mm_set1_epi8(0x0F);
+  const __m128i bits = _mm_load_si128((const __m128i *) nibble_bits);
+  uint64_t result[3];
+
+  memset(masks, 0, sizeof(BlockMasks));
+  memset(result, 0, sizeof(result));
+
+  for (int quarter = 0; quarter < 4; quarter++) {
+
+    __m128i x = _mm_loadu_si128((const __m128i *) (bytes + 16 * quarter));
+    __m128i lo = _mm_and_si128(x, low_mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), low_mask);
+    __m128i bit = _mm_shuffle_epi8(bits, lo);
+    __m128i upper = _mm_cmpgt_epi8(lo, _mm_set1_epi8(7));
+
+    for (int k = 0; k < 3; k++) {
+      __m128i row_lo = _mm_shuffle_epi8(_mm_load_si128((const __m128i *) class_bitmaps[k][0]), hi);
+      __m128i row_hi = _mm_shuffle_epi8(_mm_load_si128((const __m128i *) class_bitmaps[k][1]), hi);
+      __m128i row = _mm_blendv_epi8(row_lo, row_hi, upper);
+      __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+      result[k] |= (uint64_t) (uint16_t) _mm_movemask_epi8(hit) << (16 * quarter);
+    }
+
+    masks->apostrophe |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\''))) << (16 * quarter);
+    masks->zero |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) << (16 * quarter);
+  }
+
+  masks->vowel = result[0];
+  masks->cons = result[1];
+  masks->split = result[2];
+}
+
+#endif /* ASCII_KERNEL_X86 */
+
+/** 
+ *  \brief Select the best kernel supported by the CPU.
+ */
+
+static void select_kernel() {
+
+#ifdef ASCII_KERNEL_X86
+  __builtin_cpu_init();
+  build_bitmaps();
+
+  if (__builtin_cpu_supports("avx2"))
+    classify_block = classify_avx2;
+  else if (__builtin_cpu_supports("sse4.2"))
+    classify_block = classify_sse42;
+#endif
+}
+
+/** 
+ *  \brief Check if a buffer only has ASCII bytes, 8 bytes at a time.
+ * 
+ *  \param bytes buffer of text.
+ *  \param n_bytes number of bytes in the buffer.
+ *  \return 1 if all bytes are ASCII, 0 otherwise.
+ */
+
+static int is_ascii(const unsigned char *bytes, int n_bytes) {
+
+  uint64_t high_bits = 0, word;
+  int i = 0;
+
+  for (; i + 8 <= n_bytes; i += 8) {
+    memcpy(&word, bytes + i, 8);
+    high_bits |= word;
+  }
+
+  for (; i < n_bytes; i++)
+    high_bits |= bytes[i];
+
+  return (high_bits & 0x8080808080808080ULL) == 0;
+}
+
+/** 
+ *  \brief Count a buffer of text with the vectorized kernel.
+ *
+ *  The buffer is only handled if the CPU has a kernel and the buffer is pure ASCII, with a split
+ *  char to stop at when it is not the final buffer. The counting continues from the given state,
+ *  as the scalar path does.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param bytes buffer with the text.
+ *  \param n_bytes number of bytes in the buffer.
+ *  \param final 1 if no more text follows the buffer, 0 otherwise.
+ *  \param consumed number of bytes processed.
+ *  \param state state left by the previous text, updated to the last char counted.
+ *  \param messageStruct structure whose counters are incremented.
+ *  \return 1 if the buffer was counted, 0 if it must go through the scalar path.
+ */
+
+int ascii_kernel(const unsigned char *bytes, int n_bytes, int final, int *consumed, WordState *state,
+                 MessageStruct *messageStruct) {
+
+  BlockMasks masks;
+  BlockCarry carry;
+  int n = n_bytes;
+  int i = 0;
+
+  pthread_once(&kernel_selected, select_kernel);
+
+  if (classify_block == NULL || n_bytes == 0 || !is_ascii(bytes, n_bytes))
+    return 0;
+
+  /* stop after the last split char unless this is the final buffer */
+  if (!final) {
+    while (n > 0 && !is_split(bytes[n - 1]))
+      n--;
+
+    if (n == 0)
+      return 0;
+  }
+
+  /* class of the char before the buffer */
+  carry.split = (state->class_before & CLASS_SPLIT) != 0;
+  carry.cons = (state->class_before & CLASS_CONSONANT) != 0;
+  carry.zero = state->value_before == 0;
+
+  /* check if first char of file is vowel */
+  if (state->flag == 0) {
+    if (is_vowel(bytes[0]))
+      messageStruct->num_vowels += 1;
+    state->flag = 1;
+  }
+
+  for (; i + 64 <= n; i += 64) {
+    classify_block(bytes + i, &masks);
+    count_block(&masks, 64, &carry, messageStruct);
+  }
+
+  if (i < n) {
+    classify_scalar(bytes + i, n - i, &masks);
+    count_block(&masks, n - i, &carry, messageStruct);
+  }
+
+  /* an apostrophe counted as a split char leaves the state of a split char */
+  state->value_before = bytes[n - 1];
+  state->class_before = carry.split ? CLASS_SPLIT : char_class(bytes[n - 1]);
+  state->end_of_word = carry.split;
+
+  *consumed = n;
+
+  return 1;
+}
+
+/** 
+ *  \brief Use the given kernel instead of the one selected for the CPU.
+ *
+ *  The selection is made first, so that it does not replace the kernel afterwards. Meant for the
+ *  tests, which check every kernel against the scalar path on the same CPU.
+ * 
+ *  \param name kernel to use: avx2, sse4.2, or scalar to always take the scalar path.
+ *  \return 1 if the kernel is in use, 0 if the CPU does not support it.
+ */
+
+int ascii_kernel_force(const char *name) {
+
+  classify_fn forced = NULL;
+
+  pthread_once(&kernel_selected, select_kernel);
+
+#ifdef ASCII_KERNEL_X86
+  if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    forced = classify_avx2;
+  else if (strcmp(name, "sse4.2") == 0 && __builtin_cpu_supports("sse4.2"))
+    forced = classify_sse42;
+#endif
+
+  if (forced == NULL && strcmp(name, "scalar") != 0)
+    return 0;
+
+  classify_block = forced;
+
+  return 1;
+}
@@ -0,0 +1,25 @@
+/**
+ *  \file asciiKernel.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the vectorized counting kernel used by the workers on pure ASCII text:
+ *     \li ascii_kernel
+ *     \li ascii_kernel_force.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include "MessageStruct.h"
+
+#ifndef ASCIIKERNEL_H_
+#define ASCIIKERNEL_H_
+
+/** \brief Count a buffer with the vectorized kernel, if it is pure ASCII and the CPU supports it */
+extern int ascii_kernel(const unsigned char *bytes, int n_bytes, int final, int *consumed, WordState *state,
+                        MessageStruct *messageStruct);
+
+/** \brief Use the given kernel instead of the one selected for the CPU, to test it */
+extern int ascii_kernel_force(const char *name);
+
+#endif /* ASCIIKERNEL_H_ */
@@ -0,0 +1,202 @@
+/**
+ *  \file asciiKernelTest.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Standalone test of the vectorized ASCII kernel. Every file is cut into chunks of several sizes
+ *  and each chunk is counted with processChunk, once on the scalar path and once with each kernel,
+ *  forced with ascii_kernel_force. The counters and the boundary states must be the same. The
+ *  files are also tested with their non ASCII bytes removed, so that every chunk of them goes
+ *  through the kernel.
+ *
+ *  Definition of the operations:
+ *     \li read_file
+ *     \li strip_non_ascii
+ *     \li same_result
+ *     \li test_text
+ *     \li main.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "worker.h"
+#include "asciiKernel.h"
+
+/** \brief kernels checked against the scalar path */
+static const char *kernels[] = { "avx2", "sse4.2" };
+
+/** \brief sizes of the chunks the texts are cut into, 0 for the whole text */
+static const int chunk_sizes[] = { 1, 7, 63, 64, 65, 100, 257, 1000, 4096, 0 };
+
+/**
+ *  \brief Read a whole file.
+ *
+ *  \param file_name name of the file.
+ *  \param n_bytes number of bytes read.
+ *  \return buffer with the file, NULL if it could not be read.
+ */
+
+static unsigned char *read_file(const char *file_name, int *n_bytes) {
+
+  FILE *file = fopen(file_name, "rb");
+  unsigned char *bytes;
+  long size;
+
+  if (file == NULL)
+    return NULL;
+
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  bytes = malloc(size > 0 ? size : 1);
+  *n_bytes = fread(bytes, 1, size, file);
+
+  fclose(file);
+
+  return bytes;
+}
+
+/**
+ *  \brief Remove the bytes that are not ASCII from a text.
+ *
+ *  \param bytes text.
+ *  \param n_bytes number of bytes of the text.
+ *  \param ascii buffer for the ASCII bytes, of n_bytes.
+ *  \return number of ASCII bytes.
+ */
+
+static int strip_non_ascii(const unsigned char *bytes, int n_bytes, unsigned char *ascii) {
+
+  int n = 0;
+
+  for (int i = 0; i < n_bytes; i++)
+    if (bytes[i] < 0x80)
+      ascii[n++] = bytes[i];
+
+  return n;
+}
+
+/**
+ *  \brief Check if two results of the same chunk have the same counters and boundary states.
+ *
+ *  \param a first result.
+ *  \param b second result.
+ *  \return 1 if they are the same, 0 otherwise.
+ */
+
+static int same_result(const ChunkResult *a, const ChunkResult *b) {
+
+  return a->num_words == b->num_words && a->num_vowels == b->num_vowels && a->num_cons == b->num_cons &&
+         a->lead_apostrophes == b->lead_apostrophes && a->first_class == b->first_class &&
+         a->last_class == b->last_class && a->n_head_bytes == b->n_head_bytes &&
+         a->n_tail_bytes == b->n_tail_bytes && memcmp(a->head_bytes, b->head_bytes, a->n_head_bytes) == 0 &&
+         memcmp(a->tail_bytes, b->tail_bytes, a->n_tail_bytes) == 0;
+}
+
+/**
+ *  \brief Count the chunks of a text on the scalar path and with a kernel, and compare them.
+ *
+ *  \param name name of the text, for the messages.
+ *  \param bytes text.
+ *  \param n_bytes number of bytes of the text.
+ *  \param kernel kernel checked.
+ *  \return number of chunks whose results differ.
+ */
+
+static int test_text(const char *name, const unsigned char *bytes, int n_bytes, const char *kernel) {
+
+  ChunkResult scalar, vectorized;
+  int errors = 0;
+
+  for (int s = 0; s < (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); s++) {
+
+    int size = chunk_sizes[s] > 0 ? chunk_sizes[s] : (n_bytes > 0 ? n_bytes : 1);
+
+    for (int start = 0; start < n_bytes; start += size) {
+
+      int length = n_bytes - start < size ? n_bytes - start : size;
+
+      ascii_kernel_force("scalar");
+      processChunk(bytes + start, length, &scalar);
+
+      ascii_kernel_force(kernel);
+      processChunk(bytes + start, length, &vectorized);
+
+      if (!same_result(&scalar, &vectorized)) {
+        if (errors++ == 0)
+          fprintf(stderr, "%s: %s differs from the scalar path at byte %d, chunks of %d bytes: "
+                  "words %lld/%lld, vowels %lld/%lld, consonants %lld/%lld\n", name, kernel, start, size,
+                  vectorized.num_words, scalar.num_words, vectorized.num_vowels, scalar.num_vowels,
+                  vectorized.num_cons, scalar.num_cons);
+      }
+    }
+  }
+
+  return errors;
+}
+
+/**
+ *  \brief Main function.
+ *
+ *  Usage: asciikerneltest [filenames]. A kernel the CPU does not support is skipped.
+ *
+ *  \param argc number of words of the command line.
+ *  \param argv list of words of the command line.
+ *  \return status of operation, 1 if any chunk differs.
+ */
+
+int main(int argc, char *argv[]) {
+
+  int failed = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s [filenames]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (int k = 0; k < (int)(sizeof(kernels) / sizeof(kernels[0])); k++) {
+
+    int errors = 0;
+
+    if (!ascii_kernel_force(kernels[k])) {
+      printf("%s: not supported by this CPU, skipped\n", kernels[k]);
+      continue;
+    }
+
+    for (int i = 1; i < argc; i++) {
+
+      int n_bytes, n_ascii;
+      unsigned char *bytes = read_file(argv[i], &n_bytes);
+
+      if (bytes == NULL) {
+        fprintf(stderr, "Could not read %s\n", argv[i]);
+        return EXIT_FAILURE;
+      }
+
+      unsigned char *ascii = malloc(n_bytes > 0 ? n_bytes : 1);
+      n_ascii = strip_non_ascii(bytes, n_bytes, ascii);
+
+      char ascii_name[strlen(argv[i]) + 20];
+      sprintf(ascii_name, "%s, ASCII bytes only", argv[i]);
+
+      errors += test_text(argv[i], bytes, n_bytes, kernels[k]);
+      errors += test_text(ascii_name, ascii, n_ascii, kernels[k]);
+
+      free(bytes);
+      free(ascii);
+    }
+
+    printf("%s: %s\n", kernels[k], errors == 0 ? "same results as the scalar path" : "FAILED");
+    failed |= errors > 0;
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
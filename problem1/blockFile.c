@@ -0,0 +1,652 @@
+/**
+ *  \file blockFile.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Block-compressed files. The text is cut into blocks of the same size, cut at any byte, which
+ *  are compressed independently, so that every block can be read and decompressed without the
+ *  others. The file is laid out as:
+ *
+ *     header   "WCBLK001", size of the blocks (4 bytes), 4 bytes set to 0
+ *     blocks   the compressed blocks, one after the other
+ *     index    per block: offset (8 bytes), compressed size (4), size (4), codec (4), 4 bytes set to 0
+ *     trailer  offset of the index (8 bytes), number of blocks (8), "WCINDEX1"
+ *
+ *  All numbers are little endian. The index is written at the end, so the text can be compressed
+ *  as it is read, and is found through the trailer.
+ *
+ *  The LZ77 codec of this file needs no library. Each sequence is a token, whose high and low
+ *  nibbles hold the number of literals and the length of the match minus 4, followed by the
+ *  literals, the offset of the match (2 bytes) and the lengths that do not fit in a nibble, as
+ *  runs of bytes added up until one is not 255. The last sequence has no match. Blocks may also be
+ *  compressed with zlib, when built with HAVE_ZLIB.
+ *
+ *  Plain files are read as if they were made of stored blocks, so they can be mixed with
+ *  block-compressed files.
+ *
+ *  Definition of the operations:
+ *     \li block_bound
+ *     \li block_compress
+ *     \li block_decompress
+ *     \li block_write_header
+ *     \li block_write_index
+ *     \li block_read_index
+ *     \li block_load.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "blockFile.h"
+
+/** \brief magic bytes at the start of a block-compressed file */
+static const char header_magic[8] = { 'W', 'C', 'B', 'L', 'K', '0', '0', '1' };
+
+/** \brief magic bytes at the end of a block-compressed file */
+static const char trailer_magic[8] = { 'W', 'C', 'I', 'N', 'D', 'E', 'X', '1' };
+
+/** \brief size of an entry of the index */
+#define INDEX_ENTRY_SIZE   24
+
+/** \brief size of the trailer */
+#define TRAILER_SIZE   24
+
+/** \brief shortest match of the LZ77 codec */
+#define LZ_MIN_MATCH   4
+
+/** \brief farthest match of the LZ77 codec */
+#define LZ_MAX_OFFSET   65535
+
+/** \brief number of bits of the hash of the LZ77 codec */
+#define LZ_HASH_BITS   14
+
+/**
+ *  \brief Store a 4 byte number, little endian.
+ *
+ *  \param bytes where the number is stored.
+ *  \param value number.
+ */
+
+static void put_u32(unsigned char *bytes, uint32_t value) {
+  for (int i = 0; i < 4; i++)
+    bytes[i] = value >> (8 * i);
+}
+
+/**
+ *  \brief Store an 8 byte number, little endian.
+ *
+ *  \param bytes where the number is stored.
+ *  \param value number.
+ */
+
+static void put_u64(unsigned char *bytes, uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    bytes[i] = value >> (8 * i);
+}
+
+/**
+ *  \brief Load a 4 byte number, little endian.
+ *
+ *  \param bytes where the number is stored.
+ *  \return number.
+ */
+
+static uint32_t get_u32(const unsigned char *bytes) {
+  return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/**
+ *  \brief Load an 8 byte number, little endian.
+ *
+ *  \param bytes where the number is stored.
+ *  \return number.
+ */
+
+static uint64_t get_u64(const unsigned char *bytes) {
+  return get_u32(bytes) | (uint64_t)get_u32(bytes + 4) << 32;
+}
+
+/**
+ *  \brief Write all the bytes of a buffer.
+ *
+ *  \param fd descriptor of the file.
+ *  \param bytes buffer.
+ *  \param n_bytes number of bytes to write.
+ *  \return 1 on success, 0 otherwise.
+ */
+
+static int write_all(int fd, const unsigned char *bytes, size_t n_bytes) {
+
+  ssize_t n;
+
+  while (n_bytes > 0) {
+    n = write(fd, bytes, n_bytes);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+
+    bytes += n;
+    n_bytes -= n;
+  }
+
+  return 1;
+}
+
+/**
+ *  \brief Read all the bytes of a buffer at an offset.
+ *
+ *  \param fd descriptor of the file.
+ *  \param bytes buffer.
+ *  \param n_bytes number of bytes to read.
+ *  \param offset offset in the file of the first byte.
+ *  \return 1 on success, 0 otherwise.
+ */
+
+static int read_all(int fd, unsigned char *bytes, size_t n_bytes, long long offset) {
+
+  ssize_t n;
+
+  while (n_bytes > 0) {
+    n = pread(fd, bytes, n_bytes, offset);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+
+    bytes += n;
+    n_bytes -= n;
+    offset += n;
+  }
+
+  return 1;
+}
+
+/**
+ *  \brief Largest size of a block once compressed.
+ *
+ *  \param n_bytes size of the block.
+ *  \return number of bytes to allocate for the compressed block.
+ */
+
+int block_bound(int n_bytes) {
+  return n_bytes + n_bytes / 255 + 16;
+}
+
+/**
+ *  \brief Append a length that does not fit in a nibble.
+ *
+ *  \param dst compressed block.
+ *  \param capacity size of the buffer of the compressed block.
+ *  \param out size of the compressed block, moved past the length.
+ *  \param length length, 15 or more.
+ *  \return 1 on success, 0 if it does not fit.
+ */
+
+static int lz_put_length(unsigned char *dst, int capacity, int *out, int length) {
+
+  for (length -= 15; length >= 255; length -= 255) {
+    if (*out >= capacity)
+      return 0;
+    dst[(*out)++] = 255;
+  }
+
+  if (*out >= capacity)
+    return 0;
+  dst[(*out)++] = length;
+
+  return 1;
+}
+
+/**
+ *  \brief Append a sequence of literals followed by a match, or the last sequence if the match
+ *  length is 0.
+ *
+ *  \param dst compressed block.
+ *  \param capacity size of the buffer of the compressed block.
+ *  \param out size of the compressed block, moved past the sequence.
+ *  \param literals bytes copied as they are.
+ *  \param n_literals number of literals.
+ *  \param offset distance back to the match.
+ *  \param match_len length of the match, 0 for the last sequence.
+ *  \return 1 on success, 0 if it does not fit.
+ */
+
+static int lz_put_sequence(unsigned char *dst, int capacity, int *out, const unsigned char *literals, int n_literals,
+                           int offset, int match_len) {
+
+  int match_code = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+
+  if (*out >= capacity)
+    return 0;
+  dst[(*out)++] = (n_literals < 15 ? n_literals : 15) << 4 | (match_code < 15 ? match_code : 15);
+
+  if (n_literals >= 15 && !lz_put_length(dst, capacity, out, n_literals))
+    return 0;
+
+  if (capacity - *out < n_literals)
+    return 0;
+  memcpy(dst + *out, literals, n_literals);
+  *out += n_literals;
+
+  if (match_len == 0)
+    return 1;
+
+  if (capacity - *out < 2)
+    return 0;
+  dst[(*out)++] = offset & 0xff;
+  dst[(*out)++] = offset >> 8;
+
+  return match_code < 15 || lz_put_length(dst, capacity, out, match_code);
+}
+
+/**
+ *  \brief Read a length that does not fit in a nibble.
+ *
+ *  \param src compressed block.
+ *  \param comp_len size of the compressed block.
+ *  \param in position in the compressed block, moved past the length.
+ *  \param limit largest length allowed.
+ *  \param length length read so far, 15, to which the bytes read are added.
+ *  \return 1 on success, 0 if the block is corrupted.
+ */
+
+static int lz_get_length(const unsigned char *src, int comp_len, int *in, int limit, int *length) {
+
+  int byte;
+
+  do {
+    if (*in >= comp_len || *length > limit)
+      return 0;
+    byte = src[(*in)++];
+    *length += byte;
+  } while (byte == 255);
+
+  return 1;
+}
+
+/**
+ *  \brief Compress a block with the LZ77 codec, greedily taking the match found through a hash of
+ *  the next 4 bytes.
+ *
+ *  \param src bytes of the block.
+ *  \param n_bytes size of the block.
+ *  \param dst buffer for the compressed block.
+ *  \param capacity size of the buffer.
+ *  \return size of the compressed block, -1 if it does not fit.
+ */
+
+static int lz_compress(const unsigned char *src, int n_bytes, unsigned char *dst, int capacity) {
+
+  int *table = malloc((1 << LZ_HASH_BITS) * sizeof(int));
+  int pos = 0, anchor = 0, out = 0;
+  int candidate, length;
+  uint32_t sequence, other;
+
+  for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+    table[i] = -1;
+
+  while (pos + LZ_MIN_MATCH <= n_bytes) {
+
+    memcpy(&sequence, src + pos, 4);
+
+    uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+
+    candidate = table[hash];
+    table[hash] = pos;
+
+    if (candidate >= 0 && pos - candidate <= LZ_MAX_OFFSET) {
+      memcpy(&other, src + candidate, 4);
+
+      if (other == sequence) {
+        for (length = LZ_MIN_MATCH; pos + length < n_bytes && src[candidate + length] == src[pos + length]; length++)
+          ;
+
+        if (!lz_put_sequence(dst, capacity, &out, src + anchor, pos - anchor, pos - candidate, length)) {
+          free(table);
+          return -1;
+        }
+
+        pos += length;
+        anchor = pos;
+        continue;
+      }
+    }
+
+    pos++;
+  }
+
+  free(table);
+
+  /* the rest of the block as literals */
+  if (!lz_put_sequence(dst, capacity, &out, src + anchor, n_bytes - anchor, 0, 0))
+    return -1;
+
+  return out;
+}
+
+/**
+ *  \brief Decompress a block of the LZ77 codec, checking every length and offset.
+ *
+ *  \param src compressed block.
+ *  \param comp_len size of the compressed block.
+ *  \param dst buffer for the block, of raw_len bytes.
+ *  \param raw_len size of the block.
+ *  \return 1 on success, 0 if the block is corrupted.
+ */
+
+static int lz_decompress(const unsigned char *src, int comp_len, unsigned char *dst, int raw_len) {
+
+  int in = 0, out = 0;
+  int token, length, offset;
+
+  while (in < comp_len) {
+
+    token = src[in++];
+
+    /* literals */
+    length = token >> 4;
+    if (length == 15 && !lz_get_length(src, comp_len, &in, raw_len, &length))
+      return 0;
+
+    if (length > comp_len - in || length > raw_len - out)
+      return 0;
+
+    memcpy(dst + out, src + in, length);
+    in += length;
+    out += length;
+
+    /* the last sequence has no match */
+    if (in == comp_len)
+      break;
+
+    if (comp_len - in < 2)
+      return 0;
+
+    offset = src[in] | src[in + 1] << 8;
+    in += 2;
+
+    length = token & 15;
+    if (length == 15 && !lz_get_length(src, comp_len, &in, raw_len, &length))
+      return 0;
+    length += LZ_MIN_MATCH;
+
+    if (offset == 0 || offset > out || length > raw_len - out)
+      return 0;
+
+    /* the match may overlap the bytes it writes */
+    for (int i = 0; i < length; i++)
+      dst[out + i] = dst[out - offset + i];
+    out += length;
+  }
+
+  return out == raw_len;
+}
+
+/**
+ *  \brief Compress a block.
+ *
+ *  \param src bytes of the block.
+ *  \param n_bytes size of the block.
+ *  \param dst buffer for the compressed block.
+ *  \param capacity size of the buffer, at least block_bound(n_bytes).
+ *  \param codec codec to be used.
+ *  \return size of the compressed block, -1 if it is not smaller than the block or the codec is
+ *  not available, so the block should be stored.
+ */
+
+int block_compress(const unsigned char *src, int n_bytes, unsigned char *dst, int capacity, int codec) {
+
+  int n = -1;
+
+  if (codec == CODEC_LZ)
+    n = lz_compress(src, n_bytes, dst, capacity);
+#ifdef HAVE_ZLIB
+  else if (codec == CODEC_ZLIB) {
+    uLongf length = capacity;
+    if (compress2(dst, &length, src, n_bytes, Z_DEFAULT_COMPRESSION) == Z_OK)
+      n = length;
+  }
+#endif
+
+  return n >= 0 && n < n_bytes ? n : -1;
+}
+
+/**
+ *  \brief Decompress a block.
+ *
+ *  \param src compressed block.
+ *  \param comp_len size of the compressed block.
+ *  \param dst buffer for the block, of raw_len bytes.
+ *  \param raw_len size of the block.
+ *  \param codec codec of the block.
+ *  \return 1 on success, 0 if the block is corrupted or its codec is not available.
+ */
+
+int block_decompress(const unsigned char *src, int comp_len, unsigned char *dst, int raw_len, int codec) {
+
+  switch (codec) {
+    case CODEC_STORED:
+      if (comp_len != raw_len)
+        return 0;
+      memcpy(dst, src, raw_len);
+      return 1;
+
+    case CODEC_LZ:
+      return lz_decompress(src, comp_len, dst, raw_len);
+
+#ifdef HAVE_ZLIB
+    case CODEC_ZLIB: {
+      uLongf length = raw_len;
+      return uncompress(dst, &length, src, comp_len) == Z_OK && length == (uLongf)raw_len;
+    }
+#endif
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ *  \brief Write the header of a block-compressed file.
+ *
+ *  \param fd descriptor of the file, at its start.
+ *  \param block_bytes size of the blocks.
+ *  \return 1 on success, 0 otherwise.
+ */
+
+int block_write_header(int fd, int block_bytes) {
+
+  unsigned char header[BLOCK_HEADER_SIZE];
+
+  memcpy(header, header_magic, 8);
+  put_u32(header + 8, block_bytes);
+  put_u32(header + 12, 0);
+
+  return write_all(fd, header, BLOCK_HEADER_SIZE);
+}
+
+/**
+ *  \brief Write the index and the trailer at the end of a block-compressed file.
+ *
+ *  \param fd descriptor of the file, after the last block.
+ *  \param blocks entries of the index.
+ *  \param n_blocks number of blocks.
+ *  \param index_offset offset of the end of the last block.
+ *  \return 1 on success, 0 otherwise.
+ */
+
+int block_write_index(int fd, const BlockEntry *blocks, int n_blocks, long long index_offset) {
+
+  unsigned char entry[INDEX_ENTRY_SIZE];
+  unsigned char trailer[TRAILER_SIZE];
+
+  for (int i = 0; i < n_blocks; i++) {
+    put_u64(entry, blocks[i].offset);
+    put_u32(entry + 8, blocks[i].comp_len);
+    put_u32(entry + 12, blocks[i].raw_len);
+    put_u32(entry + 16, blocks[i].codec);
+    put_u32(entry + 20, 0);
+
+    if (!write_all(fd, entry, INDEX_ENTRY_SIZE))
+      return 0;
+  }
+
+  put_u64(trailer, index_offset);
+  put_u64(trailer + 8, n_blocks);
+  memcpy(trailer + 16, trailer_magic, 8);
+
+  return write_all(fd, trailer, TRAILER_SIZE);
+}
+
+/**
+ *  \brief Read the index of a block-compressed file.
+ *
+ *  \param fd descriptor of the file.
+ *  \param file_size size of the file.
+ *  \param index index read.
+ *  \return 1 on success, 0 if the file is not block-compressed or its index is corrupted.
+ */
+
+static int read_compressed_index(int fd, long long file_size, BlockIndex *index) {
+
+  unsigned char header[BLOCK_HEADER_SIZE];
+  unsigned char trailer[TRAILER_SIZE];
+  unsigned char *entries;
+  long long index_offset, n_blocks;
+
+  if (file_size < BLOCK_HEADER_SIZE + TRAILER_SIZE || !read_all(fd, header, BLOCK_HEADER_SIZE, 0) ||
+      memcmp(header, header_magic, 8) != 0)
+    return 0;
+
+  if (!read_all(fd, trailer, TRAILER_SIZE, file_size - TRAILER_SIZE) || memcmp(trailer + 16, trailer_magic, 8) != 0)
+    return 0;
+
+  index_offset = get_u64(trailer);
+  n_blocks = get_u64(trailer + 8);
+
+  if (index_offset < BLOCK_HEADER_SIZE || index_offset > file_size - TRAILER_SIZE || n_blocks > INT_MAX ||
+      n_blocks > (file_size - TRAILER_SIZE - index_offset) / INDEX_ENTRY_SIZE)
+    return 0;
+
+  entries = malloc(n_blocks * INDEX_ENTRY_SIZE + 1);
+  index->blocks = malloc((n_blocks + 1) * sizeof(BlockEntry));
+  index->n_blocks = n_blocks;
+  index->compressed = 1;
+
+  if (!read_all(fd, entries, n_blocks * INDEX_ENTRY_SIZE, index_offset)) {
+    free(entries);
+    free(index->blocks);
+    return 0;
+  }
+
+  for (int i = 0; i < n_blocks; i++) {
+    BlockEntry *block = &index->blocks[i];
+    const unsigned char *entry = entries + i * INDEX_ENTRY_SIZE;
+
+    block->offset = get_u64(entry);
+    block->comp_len = get_u32(entry + 8);
+    block->raw_len = get_u32(entry + 12);
+    block->codec = get_u32(entry + 16);
+
+    /* every block must lie between the header and the index */
+    if (block->comp_len < 0 || block->raw_len < 0 || block->offset < BLOCK_HEADER_SIZE ||
+        block->offset > index_offset - block->comp_len) {
+      free(entries);
+      free(index->blocks);
+      return 0;
+    }
+  }
+
+  free(entries);
+
+  return 1;
+}
+
+/**
+ *  \brief Read the index of a block-compressed file, or split a plain file into stored blocks.
+ *
+ *  \param file_name name of the file.
+ *  \param block_bytes size of the blocks of a plain file.
+ *  \param index blocks of the file, to be freed by the caller.
+ *  \return 1 on success, 0 if the file cannot be read in blocks.
+ */
+
+int block_read_index(const char *file_name, int block_bytes, BlockIndex *index) {
+
+  struct stat st;
+  int fd;
+
+  index->blocks = NULL;
+  index->n_blocks = 0;
+  index->compressed = 0;
+
+  if ((fd = open(file_name, O_RDONLY)) == -1) {
+    fprintf(stderr, "Could not open file %s: %s\n", file_name, strerror(errno));
+    return 0;
+  }
+
+  /* blocks are read at their offsets, so the file must be seekable */
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    fprintf(stderr, "File %s is not a regular file\n", file_name);
+    close(fd);
+    return 0;
+  }
+
+  if (read_compressed_index(fd, st.st_size, index)) {
+    close(fd);
+    return 1;
+  }
+
+  close(fd);
+
+  /* a plain file is a sequence of stored blocks */
+  index->n_blocks = (st.st_size + block_bytes - 1) / block_bytes;
+  index->blocks = malloc((index->n_blocks + 1) * sizeof(BlockEntry));
+
+  for (int i = 0; i < index->n_blocks; i++) {
+    index->blocks[i].offset = (long long)i * block_bytes;
+    index->blocks[i].raw_len = st.st_size - index->blocks[i].offset < block_bytes ?
+                               st.st_size - index->blocks[i].offset : block_bytes;
+    index->blocks[i].comp_len = index->blocks[i].raw_len;
+    index->blocks[i].codec = CODEC_STORED;
+  }
+
+  return 1;
+}
+
+/**
+ *  \brief Read a block and decompress it.
+ *
+ *  \param fd descriptor of the file.
+ *  \param block entry of the block.
+ *  \param comp buffer for the compressed block, of block->comp_len bytes.
+ *  \param raw buffer for the block, of block->raw_len bytes.
+ *  \return 1 on success, 0 if the block could not be read or is corrupted.
+ */
+
+int block_load(int fd, const BlockEntry *block, unsigned char *comp, unsigned char *raw) {
+
+  /* stored blocks go straight to their buffer */
+  if (block->codec == CODEC_STORED)
+    return block->comp_len == block->raw_len && read_all(fd, raw, block->raw_len, block->offset);
+
+  return read_all(fd, comp, block->comp_len, block->offset) &&
+         block_decompress(comp, block->comp_len, raw, block->raw_len, block->codec);
+}
@@ -0,0 +1,70 @@
+/**
+ *  \file blockFile.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations on block-compressed files, whose blocks are compressed
+ *  independently and listed in an index, so that any block can be read and decompressed alone:
+ *     \li block_bound
+ *     \li block_compress
+ *     \li block_decompress
+ *     \li block_write_header
+ *     \li block_write_index
+ *     \li block_read_index
+ *     \li block_load.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef BLOCKFILE_H_
+#define BLOCKFILE_H_
+
+/** \brief Block kept as it is */
+#define CODEC_STORED   0
+
+/** \brief Block compressed with the LZ77 codec of this file */
+#define CODEC_LZ       1
+
+/** \brief Block compressed with zlib, only readable when built with HAVE_ZLIB */
+#define CODEC_ZLIB     2
+
+/** \brief Size of the header at the start of a block-compressed file */
+#define BLOCK_HEADER_SIZE   16
+
+/** \brief position and size of a block */
+typedef struct {
+  long long offset;               /* offset of the compressed block in the file */
+  int comp_len;                   /* bytes of the compressed block */
+  int raw_len;                    /* bytes of the block once decompressed */
+  int codec;
+} BlockEntry;
+
+/** \brief blocks of a file */
+typedef struct {
+  BlockEntry *blocks;
+  int n_blocks;
+  int compressed;                 /* 1 for a block-compressed file, 0 for a plain file read in blocks */
+} BlockIndex;
+
+/** \brief Largest size of a block of n_bytes once compressed */
+extern int block_bound(int n_bytes);
+
+/** \brief Compress a block, returning its size or -1 if it does not get smaller */
+extern int block_compress(const unsigned char *src, int n_bytes, unsigned char *dst, int capacity, int codec);
+
+/** \brief Decompress a block, returning 1 on success and 0 if it is corrupted */
+extern int block_decompress(const unsigned char *src, int comp_len, unsigned char *dst, int raw_len, int codec);
+
+/** \brief Write the header of a block-compressed file */
+extern int block_write_header(int fd, int block_bytes);
+
+/** \brief Write the index and the trailer at the end of a block-compressed file */
+extern int block_write_index(int fd, const BlockEntry *blocks, int n_blocks, long long index_offset);
+
+/** \brief Read the index of a block-compressed file, or split a plain file into blocks */
+extern int block_read_index(const char *file_name, int block_bytes, BlockIndex *index);
+
+/** \brief Read a block and decompress it */
+extern int block_load(int fd, const BlockEntry *block, unsigned char *comp, unsigned char *raw);
+
+#endif /* BLOCKFILE_H_ */
@@ -0,0 +1,184 @@
+/**
+ *  \file blockPack.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Standalone tool that writes a block-compressed file, to be read by the block mode. The input is
+ *  read one block at a time, so it may be the standard input, and each block is compressed on its
+ *  own, or stored when it does not get smaller.
+ *
+ *  Definition of the operations:
+ *     \li read_block
+ *     \li main.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+
+#include "probConst.h"
+#include "blockFile.h"
+
+/** \brief Prints command usage */
+static void printUsage(char *cmdName)
+{
+  fprintf(stderr, "\nSynopsis: %s OPTIONS input output\n"
+                  "  OPTIONS:\n"
+                  "  -h      --- print this help\n"
+                  "  -b      --- block size in bytes (default: %d)\n"
+                  "  -z      --- compress with zlib instead of the built-in codec\n"
+                  "  input may be - for the standard input\n",
+          cmdName, BLOCK_BYTES);
+}
+
+/**
+ *  \brief Read a whole block, unless the input ends first.
+ *
+ *  \param fd descriptor of the input.
+ *  \param bytes buffer for the block.
+ *  \param block_bytes size of the block.
+ *  \return number of bytes read, -1 on error.
+ */
+
+static int read_block(int fd, unsigned char *bytes, int block_bytes) {
+
+  int total = 0;
+  ssize_t n;
+
+  while (total < block_bytes) {
+    n = read(fd, bytes + total, block_bytes - total);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n == -1)
+      return -1;
+    if (n == 0)
+      break;
+
+    total += n;
+  }
+
+  return total;
+}
+
+/**
+ *  \brief Main thread.
+ *
+ *  Compresses the input block by block and writes the index at the end.
+ */
+
+int main(int argc, char *argv[]) {
+
+  int opt;
+  int block_bytes = BLOCK_BYTES;
+  int codec = CODEC_LZ;
+  int in, out, n;
+  int n_blocks = 0, max_blocks = 1024;
+  long long offset = BLOCK_HEADER_SIZE;
+
+  while ((opt = getopt(argc, argv, "b:zh")) != -1) {
+    switch (opt) {
+      case 'b':                                                                                     /* block size */
+        if (atoi(optarg) <= 0) {
+          fprintf(stderr, "%s: non positive block size\n", basename(argv[0]));
+          printUsage(basename(argv[0]));
+          return EXIT_FAILURE;
+        }
+        block_bytes = atoi(optarg);
+        break;
+
+      case 'z':                                                                                          /* zlib */
+#ifdef HAVE_ZLIB
+        codec = CODEC_ZLIB;
+        break;
+#else
+        fprintf(stderr, "%s: built without zlib\n", basename(argv[0]));
+        return EXIT_FAILURE;
+#endif
+
+      case 'h':                                                                                      /* help mode */
+        printUsage(basename(argv[0]));
+        return EXIT_SUCCESS;
+
+      default:                                                                                  /* invalid option */
+        fprintf(stderr, "%s: invalid option\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (argc - optind != 2) {
+    fprintf(stderr, "%s: invalid format\n", basename(argv[0]));
+    printUsage(basename(argv[0]));
+    return EXIT_FAILURE;
+  }
+
+  if (strcmp(argv[optind], "-") == 0)
+    in = STDIN_FILENO;
+  else if ((in = open(argv[optind], O_RDONLY)) == -1) {
+    fprintf(stderr, "Could not open file %s: %s\n", argv[optind], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if ((out = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+    fprintf(stderr, "Could not create file %s: %s\n", argv[optind + 1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  unsigned char *raw = malloc(block_bytes);
+  unsigned char *comp = malloc(block_bound(block_bytes));
+  BlockEntry *blocks = malloc(max_blocks * sizeof(BlockEntry));
+
+  if (!block_write_header(out, block_bytes)) {
+    fprintf(stderr, "Could not write file %s: %s\n", argv[optind + 1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  while ((n = read_block(in, raw, block_bytes)) > 0) {
+
+    if (n_blocks == max_blocks) {
+      max_blocks *= 2;
+      blocks = realloc(blocks, max_blocks * sizeof(BlockEntry));
+    }
+
+    BlockEntry *block = &blocks[n_blocks++];
+    int comp_len = block_compress(raw, n, comp, block_bound(block_bytes), codec);
+
+    block->offset = offset;
+    block->raw_len = n;
+    block->codec = comp_len < 0 ? CODEC_STORED : codec;
+    block->comp_len = comp_len < 0 ? n : comp_len;
+
+    if (write(out, comp_len < 0 ? raw : comp, block->comp_len) != block->comp_len) {
+      fprintf(stderr, "Could not write file %s: %s\n", argv[optind + 1], strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+    offset += block->comp_len;
+  }
+
+  if (n < 0) {
+    fprintf(stderr, "Could not read file %s: %s\n", argv[optind], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if (!block_write_index(out, blocks, n_blocks, offset) || close(out) != 0) {
+    fprintf(stderr, "Could not write file %s: %s\n", argv[optind + 1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  printf("%d blocks, %lld bytes\n", n_blocks, offset);
+
+  free(raw);
+  free(comp);
+  free(blocks);
+
+  return EXIT_SUCCESS;
+}
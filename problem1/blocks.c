@@ -0,0 +1,220 @@
+/**
+ *  \file blocks.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Block mode. The root only reads the block indexes of the files and hands out block ids on
+ *  demand, each worker keeping MAX_IN_FLIGHT of them queued. The workers read the blocks at their
+ *  offsets and decompress them, so decompression is spread across the workers instead of being
+ *  done by the root. Block-compressed files are written by blockPack, while plain files are read
+ *  in blocks of the chunk size, so both can be mixed.
+ *
+ *  Definition of the operations:
+ *     \li blocks_dispatcher
+ *     \li blocks_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "mpiio.h"
+#include "blockFile.h"
+#include "blocks.h"
+
+/** \brief block handed out to a worker, a negative file index telling it to stop */
+typedef struct {
+  int file_index;
+  int chunk_index;
+  BlockEntry block;
+} BlockTask;
+
+/**
+ *  \brief Get the next block of the files, in file and block order.
+ *
+ *  \param indexes block indexes of the files.
+ *  \param num_files number of files.
+ *  \param file file of the next block, updated.
+ *  \param block index of the next block in its file, updated.
+ *  \param task task of the block.
+ *  \return true if there was still a block, false otherwise.
+ */
+
+static bool next_block(const BlockIndex *indexes, int num_files, int *file, int *block, BlockTask *task) {
+
+  while (*file < num_files && *block >= indexes[*file].n_blocks) {
+    (*file)++;
+    *block = 0;
+  }
+
+  if (*file == num_files)
+    return false;
+
+  task->file_index = *file;
+  task->chunk_index = *block;
+  task->block = indexes[*file].blocks[*block];
+  (*block)++;
+
+  return true;
+}
+
+/**
+ *  \brief block dispatcher.
+ *
+ *  Shares the file names, reads the block indexes and hands out the blocks to the workers as they
+ *  return the results of the previous ones.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param block_bytes size of the blocks of the plain files.
+ */
+
+void blocks_dispatcher(char *file_names[], unsigned int num_files, int block_bytes) {
+
+  struct timespec start, finish;
+  int n_files = num_files;
+  int n_workers, in_flight = 0;
+  int file = 0, block = 0;
+  BlockTask task;
+  ChunkResult result;
+  MPI_Status status;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &n_workers);
+  n_workers -= 1;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  share_file_names(&file_names, &n_files);
+
+  BlockIndex *indexes = malloc(n_files * sizeof(BlockIndex));
+
+  for (int i = 0; i < n_files; i++) {
+    block_read_index(file_names[i], block_bytes, &indexes[i]);
+    set_file_chunks(i, indexes[i].n_blocks);
+  }
+
+  /* fill the queue of every worker */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++)
+    for (int worker_id = 1; worker_id <= n_workers && next_block(indexes, n_files, &file, &block, &task); worker_id++) {
+      MPI_Send(&task, sizeof(BlockTask), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+      in_flight++;
+    }
+
+  /* a worker that returns a result gets the next block */
+  while (in_flight > 0) {
+
+    MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    in_flight--;
+
+    save_file_results(&result);
+
+    if (next_block(indexes, n_files, &file, &block, &task)) {
+      MPI_Send(&task, sizeof(BlockTask), MPI_BYTE, status.MPI_SOURCE, 0, MPI_COMM_WORLD);
+      in_flight++;
+    }
+  }
+
+  /* signal workers that there is no more work to be done */
+  task.file_index = -1;
+  for (int worker_id = 1; worker_id <= n_workers; worker_id++)
+    MPI_Send(&task, sizeof(BlockTask), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  for (int i = 0; i < n_files; i++)
+    free(indexes[i].blocks);
+  free(indexes);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief block worker.
+ *
+ *  Reads each block handed out at its offset, decompresses it, processes it and sends its partial
+ *  results back. A block that cannot be read is counted as empty.
+ *
+ *  \param rank worker id.
+ */
+
+void blocks_worker(int rank) {
+
+  char **file_names = NULL;
+  int num_files;
+  BlockTask task;
+  ChunkResult result;
+  unsigned char *comp = NULL, *raw = NULL;
+  int comp_size = 0, raw_size = 0;
+  bool loaded;
+
+  share_file_names(&file_names, &num_files);
+
+  /* files are opened the first time one of their blocks comes in */
+  int *fds = malloc(num_files * sizeof(int));
+
+  for (int i = 0; i < num_files; i++)
+    fds[i] = -1;
+
+  while (true) {
+
+    MPI_Recv(&task, sizeof(BlockTask), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    /* if no more work */
+    if (task.file_index < 0)
+      break;
+
+    if (task.block.comp_len > comp_size) {
+      comp_size = task.block.comp_len;
+      comp = realloc(comp, comp_size);
+    }
+
+    if (task.block.raw_len > raw_size) {
+      raw_size = task.block.raw_len;
+      raw = realloc(raw, raw_size);
+    }
+
+    if (fds[task.file_index] == -1)
+      fds[task.file_index] = open(file_names[task.file_index], O_RDONLY);
+
+    loaded = fds[task.file_index] != -1 && block_load(fds[task.file_index], &task.block, comp, raw);
+
+    if (!loaded)
+      fprintf(stderr, "Worker %d: could not read block %d of file %s\n", rank, task.chunk_index,
+              file_names[task.file_index]);
+
+    processChunk(raw, loaded ? task.block.raw_len : 0, &result);
+
+    result.file_index = task.file_index;
+    result.chunk_index = task.chunk_index;
+
+    MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+  }
+
+  for (int i = 0; i < num_files; i++) {
+    if (fds[i] != -1)
+      close(fds[i]);
+    free(file_names[i]);
+  }
+
+  free(fds);
+  free(file_names);
+  free(comp);
+  free(raw);
+}
@@ -0,0 +1,23 @@
+/**
+ *  \file blocks.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the block mode, where the workers read and decompress the
+ *  blocks of the files themselves:
+ *     \li blocks_dispatcher
+ *     \li blocks_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef BLOCKS_H_
+#define BLOCKS_H_
+
+/** \brief Read the block indexes, hand out the blocks on demand and merge their results */
+extern void blocks_dispatcher(char *file_names[], unsigned int num_files, int block_bytes);
+
+/** \brief Read, decompress and process the blocks handed out by the dispatcher */
+extern void blocks_worker(int rank);
+
+#endif /* BLOCKS_H_ */
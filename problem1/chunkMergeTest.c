@@ -0,0 +1,241 @@
+/**
+ *  \file chunkMergeTest.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Standalone test of the merge of chunk results. Each text is counted in a single pass with
+ *  processBytes, and again cut into chunks of many sizes, counted with processChunk and merged with
+ *  result_merge, both in order and pairwise as a reduction tree does. The counters must be the same
+ *  for every size. Besides the given files, texts are built at random from valid chars, invalid
+ *  bytes, stray continuation bytes and chars cut short, so that the chunks are cut inside and
+ *  around every kind of invalid UTF-8.
+ *
+ *  Definition of the operations:
+ *     \li read_file
+ *     \li random_text
+ *     \li merge_in_order
+ *     \li merge_pairwise
+ *     \li test_text
+ *     \li main.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "worker.h"
+#include "partialResult.h"
+
+/** \brief number of random texts */
+#define N_RANDOM_TEXTS   2000
+
+/** \brief largest number of pieces of a random text */
+#define MAX_PIECES       40
+
+/** \brief largest chunk size tried on every text, besides the ones of chunk_sizes */
+#define MAX_SMALL_CHUNK  16
+
+/** \brief pieces the random texts are built from */
+static const char *pieces[] = {
+  "a", "b", "e", "x", " ", "  ", "'", ".", "\n",                   /* ASCII */
+  "\xC3\xA9", "\xC3\xA7", "\xE2\x80\x99", "\xE2\x80\x94",           /* é, ç, right single quote, em dash */
+  "\xF0\x9F\x98\x80",                                               /* 4 byte char */
+  "\x80", "\xBF", "\x80\x80\x80\x80",                               /* stray continuation bytes */
+  "\xFF", "\xC0", "\xC1\xBF", "\xF5", "\xF8\x88\x80\x80",          /* bytes that never start a char */
+  "\xC3", "\xE2\x80", "\xF0\x9F", "\xF0\x9F\x98",                   /* chars cut short */
+  "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80",               /* overlong, surrogate, too large */
+};
+
+/** \brief sizes of the chunks tried on the given files, besides the small ones */
+static const int chunk_sizes[] = { 63, 64, 100, 257, 1000, 4096 };
+
+/**
+ *  \brief Read a whole file.
+ *
+ *  \param file_name name of the file.
+ *  \param n_bytes number of bytes read.
+ *  \return buffer with the file, NULL if it could not be read.
+ */
+
+static unsigned char *read_file(const char *file_name, int *n_bytes) {
+
+  FILE *file = fopen(file_name, "rb");
+  unsigned char *bytes;
+  long size;
+
+  if (file == NULL)
+    return NULL;
+
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  bytes = malloc(size > 0 ? size : 1);
+  *n_bytes = fread(bytes, 1, size, file);
+
+  fclose(file);
+
+  return bytes;
+}
+
+/**
+ *  \brief Build a random text from the pieces.
+ *
+ *  \param bytes buffer for the text, with room for MAX_PIECES pieces.
+ *  \return number of bytes of the text.
+ */
+
+static int random_text(unsigned char *bytes) {
+
+  int n_pieces = rand() % (MAX_PIECES + 1);
+  int n_bytes = 0;
+
+  for (int i = 0; i < n_pieces; i++) {
+    const char *piece = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+
+    memcpy(bytes + n_bytes, piece, strlen(piece));
+    n_bytes += strlen(piece);
+  }
+
+  return n_bytes;
+}
+
+/**
+ *  \brief Merge the results of the chunks in order, as the dispatcher does.
+ *
+ *  \param results results of the chunks.
+ *  \param n_results number of results.
+ *  \param merged merged result.
+ */
+
+static void merge_in_order(const ChunkResult *results, int n_results, ChunkResult *merged) {
+
+  result_init(merged, 0);
+
+  for (int i = 0; i < n_results; i++)
+    result_merge(merged, &results[i], merged);
+}
+
+/**
+ *  \brief Merge the results of the chunks pairwise, as a reduction tree does.
+ *
+ *  \param results results of the chunks, replaced by partial merges.
+ *  \param n_results number of results.
+ *  \param merged merged result.
+ */
+
+static void merge_pairwise(ChunkResult *results, int n_results, ChunkResult *merged) {
+
+  result_init(merged, 0);
+
+  for (int step = 1; step < n_results; step *= 2)
+    for (int i = 0; i + step < n_results; i += 2 * step)
+      result_merge(&results[i], &results[i + step], &results[i]);
+
+  if (n_results > 0)
+    result_merge(merged, &results[0], merged);
+}
+
+/**
+ *  \brief Count a text in a single pass and in chunks of a given size, and compare the counters.
+ *
+ *  \param name name of the text, for the messages.
+ *  \param bytes text.
+ *  \param n_bytes number of bytes of the text.
+ *  \param size size of the chunks.
+ *  \return 1 if the counters differ, 0 otherwise.
+ */
+
+static int test_text(const char *name, const unsigned char *bytes, int n_bytes, int size) {
+
+  static MessageStruct whole;
+  int n_results = (n_bytes + size - 1) / size;
+  ChunkResult *results = malloc((n_results > 0 ? n_results : 1) * sizeof(ChunkResult));
+  ChunkResult merged[2];
+  long long counters[2][3];
+
+  processBytes(bytes, n_bytes, 1, &whole);
+
+  for (int i = 0; i < n_results; i++) {
+    int start = i * size;
+
+    processChunk(bytes + start, n_bytes - start < size ? n_bytes - start : size, &results[i]);
+    results[i].file_index = 0;
+    results[i].chunk_index = i;
+  }
+
+  merge_in_order(results, n_results, &merged[0]);
+  merge_pairwise(results, n_results, &merged[1]);
+
+  free(results);
+
+  for (int m = 0; m < 2; m++) {
+    result_finish(&merged[m], &counters[m][0], &counters[m][1], &counters[m][2]);
+
+    if (counters[m][0] != whole.num_words || counters[m][1] != whole.num_vowels || counters[m][2] != whole.num_cons) {
+      fprintf(stderr, "%s: chunks of %d bytes merged %s: words %lld/%d, vowels %lld/%d, consonants %lld/%d\n",
+              name, size, m == 0 ? "in order" : "pairwise", counters[m][0], whole.num_words, counters[m][1],
+              whole.num_vowels, counters[m][2], whole.num_cons);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Main function.
+ *
+ *  Usage: chunkmergetest [filenames]. The random texts are always tested.
+ *
+ *  \param argc number of words of the command line.
+ *  \param argv list of words of the command line.
+ *  \return status of operation, 1 if any counter differs.
+ */
+
+int main(int argc, char *argv[]) {
+
+  static unsigned char text[MAX_PIECES * 4];
+  char name[32];
+  int errors = 0;
+
+  srand(1);
+
+  for (int t = 0; t < N_RANDOM_TEXTS; t++) {
+
+    int n_bytes = random_text(text);
+
+    sprintf(name, "random text %d", t);
+
+    for (int size = 1; size <= MAX_SMALL_CHUNK; size++)
+      errors += test_text(name, text, n_bytes, size);
+  }
+
+  for (int i = 1; i < argc; i++) {
+
+    int n_bytes;
+    unsigned char *bytes = read_file(argv[i], &n_bytes);
+
+    if (bytes == NULL) {
+      fprintf(stderr, "Could not read %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    for (int size = 1; size <= MAX_SMALL_CHUNK; size++)
+      errors += test_text(argv[i], bytes, n_bytes, size);
+
+    for (int s = 0; s < (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); s++)
+      errors += test_text(argv[i], bytes, n_bytes, chunk_sizes[s]);
+
+    free(bytes);
+  }
+
+  printf("%s\n", errors == 0 ? "same counters for every chunk size" : "FAILED");
+
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,24 +5,43 @@
  *
  *
  *  Definition of the operations carried out by the dispatcher:
+ *     \li set_journal
+ *     \li set_cache
+ *     \li set_output
+ *     \li keep_file_maps
  *     \li allocateMemory
  *     \li check_for_file
  *     \li check_close_file
- *     \li get_int
- *     \li getVal
+ *     \li getChunkView
+ *     \li getChunk
+ *     \li wait_for_input
+ *     \li input_bytes_left
+ *     \li set_file_chunks
  *     \li save_file_results
- *     \li print_final_results.
+ *     \li add_file_counters
+ *     \li print_rolling_results
+ *     \li print_final_results
+ *     \li print_elapsed.
  *
  *  \author Eduardo Santos and Pedro Bastos - May 2022
  */
 
 #include "MessageStruct.h"
 #include "worker.h"
+#include "partialResult.h"
+#include "dispatcher.h"
+#include "resultCache.h"
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <time.h>
 #include "probConst.h"
 
 /** \brief pointer to save the filenames */
@@ -32,13 +51,31 @@ char **file_names;
 int num_files;
 
 /** \brief array to save the total number of words for each file */
-int *array_num_words;
+long long *array_num_words;
 
 /** \brief array to save the number of words beginning with a vowel for each file */
-int *array_num_vowels;
+long long *array_num_vowels;
 
 /** \brief array to save the number of words ending with a consonant for each file */
-int *array_num_cons;
+long long *array_num_cons;
+
+/** \brief merged results of the chunks of each file received so far, in file order */
+ChunkResult *file_results;
+
+/** \brief index of the next chunk to be merged for each file */
+int *next_chunk;
+
+/** \brief results received ahead of their turn, waiting for the chunks before them */
+ChunkResult *pending_results;
+
+/** \brief number of results waiting */
+int num_pending = 0;
+
+/** \brief number of results that fit in the waiting array */
+int max_pending = 0;
+
+/** \brief index of the next chunk of the current file */
+int index_chunk = 0;
 
 /** \brief variable to save the current file index */
 int index_file = -1;
@@ -49,8 +86,269 @@ int open_file = 0;
 /** \brief flag that indicates if the file was already closed */
 int close_file = 0;
 
-/** \brief pointer to the file */
-FILE *fp;
+/** \brief descriptor of the current file, -1 if it could not be opened */
+int fd = -1;
+
+/** \brief contents of the current file when it is memory mapped, NULL otherwise */
+unsigned char *file_data = NULL;
+
+/** \brief size of the current file when it is memory mapped */
+size_t file_size = 0;
+
+/** \brief buffer of the current file when it is streamed with read() */
+unsigned char *stream_buf = NULL;
+
+/** \brief number of bytes in the stream buffer */
+size_t stream_len = 0;
+
+/** \brief offset of the next chunk in the mapped file or in the stream buffer */
+size_t file_offset = 0;
+
+/** \brief size of each file, -1 if it is not a regular file */
+long long *file_sizes = NULL;
+
+/** \brief offset each file is read from, past the part counted before a resume */
+long long *start_offsets = NULL;
+
+/** \brief device, inode and modification time of a file, which tell a file edited in place at the same size */
+typedef struct {
+    long long device;
+    long long inode;
+    long long mtime_sec;
+    long long mtime_nsec;
+} FileStamp;
+
+/** \brief device, inode and modification time of each regular file, zeros otherwise */
+FileStamp *file_stamps = NULL;
+
+/** \brief name of the progress journal, NULL if none is kept */
+const char *journal_name = NULL;
+
+/** \brief seconds between two writes of the journal */
+double journal_interval = 0;
+
+/** \brief 1 if the progress saved in the journal is loaded at the start */
+int journal_resume = 0;
+
+/** \brief time of the last write of the journal */
+struct timespec journal_time;
+
+/** \brief name of the result cache, NULL if none is kept */
+const char *cache_file = NULL;
+
+/** \brief 1 for each file whose counters were found in the cache */
+int *cached = NULL;
+
+/** \brief hash of the contents of each file read so far */
+uint64_t *file_hashes = NULL;
+
+/** \brief when the results of each file are printed: EMIT_END, EMIT_COMPLETION or EMIT_ORDER */
+int emit_when = EMIT_END;
+
+/** \brief 1 to print the results as JSON lines, 0 as text */
+int emit_json = 0;
+
+/** \brief number of chunks of each file, -1 until the last one was handed out */
+int *file_chunks = NULL;
+
+/** \brief 1 for each file whose results were printed */
+int *emitted = NULL;
+
+/** \brief next file to be printed in argument order */
+int next_emit = 0;
+
+/** \brief 1 if the mapped files stay mapped until all their chunks are merged */
+int keep_maps = 0;
+
+/** \brief mapping of each file closed while its chunks may still be processed, NULL if none */
+unsigned char **file_maps = NULL;
+
+/** \brief size of the mapping of each file */
+size_t *file_map_sizes = NULL;
+
+/** \brief lock held by the threads that merge the results while the chunks are read, NULL if none */
+pthread_mutex_t *merge_lock = NULL;
+
+/**
+ *  \brief Keep a progress journal.
+ *
+ *  The journal records, for every file, the merged result of the chunks counted so far, which
+ *  covers a prefix of the file. It is written every interval seconds and at the end, to a
+ *  temporary file renamed over the journal, so a crash leaves either the old or the new journal.
+ *
+ *  Operation carried out by the dispatcher, before allocateMemory.
+ *
+ *  \param name name of the journal.
+ *  \param interval seconds between two writes of the journal.
+ *  \param resume 1 to load the journal and skip the work it records.
+ */
+
+void set_journal(const char *name, double interval, int resume){
+    journal_name = name;
+    journal_interval = interval;
+    journal_resume = resume;
+}
+
+/**
+ *  \brief Keep a result cache.
+ *
+ *  The files found unchanged in the cache are not read, and the counters of all the files are
+ *  saved to the cache at the end.
+ *
+ *  Operation carried out by the dispatcher, before allocateMemory.
+ *
+ *  \param name name of the cache.
+ */
+
+void set_cache(const char *name){
+    cache_file = name;
+}
+
+/**
+ *  \brief Choose when and how the results of each file are printed.
+ *
+ *  At the end, all the files in argument order, or as soon as the last chunk of a file is merged,
+ *  either right away or once the files before it are printed too.
+ *
+ *  Operation carried out by the dispatcher, before allocateMemory.
+ *
+ *  \param when EMIT_END, EMIT_COMPLETION or EMIT_ORDER.
+ *  \param json 1 for JSON lines, 0 for text.
+ */
+
+void set_output(int when, int json){
+    emit_when = when;
+    emit_json = json;
+}
+
+/**
+ *  \brief Keep the mapped files until all their chunks are merged.
+ *
+ *  The views of a mapped file then stay valid after the next read, so they can be processed in
+ *  place while the following chunks are read. The mapping is released once the last chunk of the
+ *  file is merged.
+ *
+ *  The merges may then run on other threads while the chunks are read. The reading takes their
+ *  lock only when it closes a file, to hand over its mapping and its number of chunks, so that they
+ *  do not wait for the I/O.
+ *
+ *  Operation carried out by the dispatcher, before allocateMemory.
+ *
+ *  \param lock lock held by the threads around save_file_results.
+ */
+
+void keep_file_maps(pthread_mutex_t *lock){
+    keep_maps = 1;
+    merge_lock = lock;
+}
+
+/**
+ *  \brief Write the progress of every file to the journal.
+ *
+ *  One line per file: bytes counted, next chunk, size, device, inode and modification time of the
+ *  file, the counters and boundary state of its merged result, and the file name.
+ */
+
+static void write_journal(){
+
+    char tmp_name[4096];
+    FILE *journal;
+    const ChunkResult *r;
+    const FileStamp *f;
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", journal_name);
+
+    if((journal = fopen(tmp_name, "w")) == NULL){
+        fprintf(stderr, "Could not write journal %s: %s\n", tmp_name, strerror(errno));
+        return;
+    }
+
+    fprintf(journal, "# bytes next_chunk size device inode mtime mtime_nsec words vowels cons apostrophes first last head tail name\n");
+
+    for(int i = 0; i < num_files; i++){
+        r = &file_results[i];
+        f = &file_stamps[i];
+        fprintf(journal, "%lld %d %lld %lld %lld %lld %lld %lld %lld %lld %lld %d %d %d:%02x%02x%02x %d:%02x%02x%02x %s\n",
+                r->n_bytes, next_chunk[i], file_sizes[i], f->device, f->inode, f->mtime_sec, f->mtime_nsec, r->num_words, r->num_vowels, r->num_cons,
+                r->lead_apostrophes, r->first_class, r->last_class,
+                r->n_head_bytes, r->head_bytes[0], r->head_bytes[1], r->head_bytes[2],
+                r->n_tail_bytes, r->tail_bytes[0], r->tail_bytes[1], r->tail_bytes[2], file_names[i]);
+    }
+
+    /* the new journal only replaces the old one once it is safely on disk */
+    if(fflush(journal) != 0 || fsync(fileno(journal)) != 0 || fclose(journal) != 0 || rename(tmp_name, journal_name) != 0)
+        fprintf(stderr, "Could not write journal %s: %s\n", journal_name, strerror(errno));
+
+    clock_gettime(CLOCK_MONOTONIC, &journal_time);
+}
+
+/**
+ *  \brief Load the progress of the files from the journal.
+ *
+ *  A line is only used for a regular file with the same name, size, device, inode and modification
+ *  time, taken in order when a name is given more than once.
+ */
+
+static void load_journal(){
+
+    char line[4096 + 256];
+    FILE *journal;
+    ChunkResult r;
+    FileStamp f;
+    int next, name_at, used;
+    long long size;
+    unsigned int head[3], tail[3];
+    int *loaded = calloc(num_files, sizeof(int));
+
+    if((journal = fopen(journal_name, "r")) == NULL){
+        fprintf(stderr, "Could not read journal %s: %s, starting from scratch\n", journal_name, strerror(errno));
+        free(loaded);
+        return;
+    }
+
+    while(fgets(line, sizeof(line), journal) != NULL){
+
+        if(line[0] == '#')
+            continue;
+
+        line[strcspn(line, "\n")] = '\0';
+
+        result_init(&r, 0);
+        if(sscanf(line, "%lld %d %lld %lld %lld %lld %lld %lld %lld %lld %lld %d %d %d:%2x%2x%2x %d:%2x%2x%2x %n", &r.n_bytes,
+                  &next, &size, &f.device, &f.inode, &f.mtime_sec, &f.mtime_nsec, &r.num_words, &r.num_vowels,
+                  &r.num_cons, &r.lead_apostrophes, &r.first_class, &r.last_class, &r.n_head_bytes, &head[0],
+                  &head[1], &head[2], &r.n_tail_bytes, &tail[0], &tail[1], &tail[2], &name_at) < 21)
+            continue;
+
+        for(int k = 0; k < 3; k++){
+            r.head_bytes[k] = head[k];
+            r.tail_bytes[k] = tail[k];
+        }
+
+        used = 0;
+        for(int i = 0; i < num_files && !used; i++){
+            if(loaded[i] || strcmp(file_names[i], line + name_at) != 0)
+                continue;
+
+            if(file_sizes[i] < 0 || size != file_sizes[i] || r.n_bytes > size || f.device != file_stamps[i].device ||
+               f.inode != file_stamps[i].inode || f.mtime_sec != file_stamps[i].mtime_sec ||
+               f.mtime_nsec != file_stamps[i].mtime_nsec){
+                fprintf(stderr, "File %s changed since the journal was written, counting it again\n", file_names[i]);
+                loaded[i] = used = 1;
+                continue;
+            }
+
+            r.file_index = i;
+            file_results[i] = r;
+            next_chunk[i] = next;
+            start_offsets[i] = r.n_bytes;
+            loaded[i] = used = 1;
+        }
+    }
+
+    fclose(journal);
+    free(loaded);
+}
 
 
 /** 
@@ -69,20 +367,81 @@ void allocateMemory(char *filenames[], unsigned int numfiles){
     num_files = numfiles;
 
     /* allocate the needed space in the arrays to save the results */
-    array_num_words = (int *)malloc(num_files * sizeof(int));
-    array_num_vowels = (int *)malloc(num_files * sizeof(int));
-    array_num_cons = (int *)malloc(num_files * sizeof(int));
+    array_num_words = (long long *)malloc(num_files * sizeof(long long));
+    array_num_vowels = (long long *)malloc(num_files * sizeof(long long));
+    array_num_cons = (long long *)malloc(num_files * sizeof(long long));
+    file_results = (ChunkResult *)malloc(num_files * sizeof(ChunkResult));
+    next_chunk = (int *)malloc(num_files * sizeof(int));
+    file_sizes = (long long *)malloc(num_files * sizeof(long long));
+    start_offsets = (long long *)calloc(num_files, sizeof(long long));
+    file_stamps = (FileStamp *)calloc(num_files, sizeof(FileStamp));
+    cached = (int *)calloc(num_files, sizeof(int));
+    file_hashes = (uint64_t *)malloc(num_files * sizeof(uint64_t));
+    file_chunks = (int *)malloc(num_files * sizeof(int));
+    emitted = (int *)calloc(num_files, sizeof(int));
+    file_maps = (unsigned char **)calloc(num_files, sizeof(unsigned char *));
+    file_map_sizes = (size_t *)calloc(num_files, sizeof(size_t));
 
     for(int i = 0; i < num_files; i++){
+        struct stat st;
+
+        if(strcmp(file_names[i], "-") == 0)
+            file_sizes[i] = -1;
+        else if(stat(file_names[i], &st) != 0)
+            file_sizes[i] = 0;
+        else if(!S_ISREG(st.st_mode))
+            file_sizes[i] = -1;
+        else{
+            file_sizes[i] = st.st_size;
+            file_stamps[i].device = st.st_dev;
+            file_stamps[i].inode = st.st_ino;
+            file_stamps[i].mtime_sec = st.st_mtime;
+#ifdef __APPLE__
+            file_stamps[i].mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+            file_stamps[i].mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+        }
+
         array_num_words[i] = 0;
         array_num_vowels[i] = 0;
         array_num_cons[i] = 0;
+        result_init(&file_results[i], i);
+        next_chunk[i] = 0;
+        file_chunks[i] = -1;
+    }
+
+    if(journal_name != NULL){
+        if(journal_resume)
+            load_journal();
+        clock_gettime(CLOCK_MONOTONIC, &journal_time);
     }
 
+    /* files found in the cache are not counted again */
+    if(cache_file != NULL){
+        long long counters[3];
+
+        cache_load(cache_file);
+
+        for(int i = 0; i < num_files; i++){
+            if(cache_lookup(file_names[i], counters, &file_hashes[i])){
+                cached[i] = 1;
+                add_file_counters(i, counters[0], counters[1], counters[2]);
+            }
+        }
+    }
+
+    /* the files that are not read again are already complete */
+    for(int i = 0; i < num_files; i++)
+        if(cached[i] || (start_offsets[i] > 0 && start_offsets[i] == file_sizes[i]))
+            set_file_chunks(i, next_chunk[i]);
 }
 
 /** 
  *  \brief Open the next file, if available.
+ *
+ *  Regular files are memory mapped. Other files, or files that cannot be mapped, are streamed
+ *  with large read() calls and sequential read-ahead. The name "-" stands for the standard input.
  *  
  *  Operation carried out by the dispatcher.
  * 
@@ -92,13 +451,53 @@ void allocateMemory(char *filenames[], unsigned int numfiles){
 int check_for_file() {
 
   int flag_file = 1;
+  struct stat st;
   index_file++;
 
+  /* files counted to the end before a resume are not read again */
+  while (index_file < num_files && (cached[index_file] ||
+         (start_offsets[index_file] > 0 && start_offsets[index_file] == file_sizes[index_file])))
+    index_file++;
+
   /* if there is still files to open */
   if (index_file < num_files) {
       close_file = 0;
       open_file = 1;
-      fp = fopen(file_names[index_file], "r");
+      index_chunk = next_chunk[index_file];
+      file_offset = 0;
+      file_hashes[index_file] = CACHE_HASH_INIT;
+      stream_len = 0;
+      file_data = NULL;
+
+      if (strcmp(file_names[index_file], "-") == 0)
+        fd = STDIN_FILENO;
+      else
+        fd = open(file_names[index_file], O_RDONLY);
+
+      if (fd == -1) {
+        fprintf(stderr, "Could not open file %s: %s\n", file_names[index_file], strerror(errno));
+        return flag_file;
+      }
+
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        file_data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (file_data == MAP_FAILED)
+          file_data = NULL;
+        else {
+          file_size = st.st_size;
+          file_offset = start_offsets[index_file];
+          madvise(file_data, file_size, MADV_SEQUENTIAL);
+        }
+      }
+
+      if (file_data == NULL) {
+        if (start_offsets[index_file] > 0)
+          lseek(fd, start_offsets[index_file], SEEK_SET);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (stream_buf == NULL)
+          stream_buf = (unsigned char *)malloc(READ_BLOCK);
+      }
   }
   else{
     flag_file = 0;
@@ -115,61 +514,95 @@ int check_for_file() {
  */
 
 void check_close_file() {
-  if (!close_file) {                                            
-    fclose(fp);
+  if (!close_file) {
+    if (file_data != NULL && keep_maps) {
+      file_maps[index_file] = file_data;
+      file_map_sizes[index_file] = file_size;
+    }
+    else if (file_data != NULL)
+      munmap(file_data, file_size);
+    if (fd != -1 && fd != STDIN_FILENO)
+      close(fd);
+    file_data = NULL;
+    fd = -1;
     close_file = 1;
     open_file = 0;
   }
 }
 
 /** 
- *  \brief Calculate the next char and convert it to integer.
+ *  \brief open each file and get a view of its next chunk, without copying it.
+ *
+ *  Chunks have a fixed size and may end anywhere in the text, even in the middle of a char, as
+ *  the partial results keep the state at the chunk boundaries. The view points into the mapped
+ *  file, or into the stream buffer, where it stays valid until the next call. After keep_file_maps,
+ *  a view of a mapped file is marked stable and stays valid until the chunks of the file are merged.
  *  
  *  Operation carried out by the dispatcher.
  * 
- *  \param fp pointer to file.
- *  \return value.
+ *  \param view view to save the position and size of the chunk.
+ *  \param max_bytes maximum size of the chunk.
+ *  \return 1 if still data to read, 0 otherwise.
  */
 
-int get_int(FILE *fp) {
+int getChunkView(ChunkView *view, int max_bytes){
 
-  int ch_value = fgetc(fp);
-  int b = 0;
+    int available = 1;
+    ssize_t n;
 
-  if (ch_value == -1) /* if EOF */
-    return -1;
+    view->bytes = NULL;
+    view->n_bytes = 0;
+    view->stable = 0;
 
-  if ((ch_value & 128) == 0) { /* if is only 1 byte char, return it */
-    return ch_value;
-  }
+    /* if file not opened */
+    if(!open_file){
+        available = check_for_file();
+    }
 
-  /* if contains 226 ('e2'), then it is a 3 byte char */
-  if (ch_value == 226) { 
-    b = 3;
-    ch_value = ch_value & (1 << 4) - 1;
-  }
+    /* if file available */
+    if(available && file_data != NULL){
+        view->bytes = file_data + file_offset;
+        view->n_bytes = file_size - file_offset < (size_t)max_bytes ? file_size - file_offset : (size_t)max_bytes;
+        view->stable = keep_maps;
+    }
+    else if(available && fd != -1){
 
-  /* else, is a 2 byte char */
-  else {
-    b = 2;
-    ch_value = ch_value & (1 << 5) - 1;
-  }
+        /* refill the stream buffer once it is used up */
+        if(file_offset == stream_len){
+            do {
+                n = read(fd, stream_buf, READ_BLOCK);
+            } while (n == -1 && errno == EINTR);
 
-  /* go through number of the char bytes */
-  for (int x = 1; x < b; x++) {
+            stream_len = n > 0 ? n : 0;
+            file_offset = 0;
+        }
+
+        view->bytes = stream_buf + file_offset;
+        view->n_bytes = stream_len - file_offset < (size_t)max_bytes ? stream_len - file_offset : (size_t)max_bytes;
+    }
 
-    /* get next byte */
-    int next_ch_value = fgetc(fp);
+    file_offset += view->n_bytes;
 
-    /* if EOF */
-    if (next_ch_value == -1)
-      return -1;
+    /* the contents of the file are hashed as they are read, for the cache */
+    if(cache_file != NULL && view->n_bytes > 0)
+        file_hashes[index_file] = cache_hash_update(file_hashes[index_file], view->bytes, view->n_bytes);
 
-    /* calculate int value of the char */
-    ch_value = (ch_value << 6) | (next_ch_value & 63);
-  }
+    /* save file and chunk index */
+    view->file_index = index_file;
+    view->chunk_index = index_chunk++;
 
-  return ch_value;
+    /* if 0 bytes are read, is EOF, and this empty chunk is the last one of the file */
+    if(view->n_bytes == 0){
+        if(merge_lock != NULL)
+            pthread_mutex_lock(merge_lock);
+        if(available)
+            set_file_chunks(index_file, index_chunk);
+        check_close_file();
+        if(merge_lock != NULL)
+            pthread_mutex_unlock(merge_lock);
+    }
+
+    return available;
 }
 
 /** 
@@ -177,93 +610,392 @@ int get_int(FILE *fp) {
  *  
  *  Operation carried out by the dispatcher.
  * 
- *  \param MessageStuct message struct to save the chunk information.
+ *  \param chunk chunk to save the raw bytes and the header.
+ *  \param max_bytes maximum size of the chunk, that must fit in its buffer.
  *  \return 1 if still data to read, 0 otherwise.
  */
 
-int getVal(MessageStruct *MessageStruct){
+int getChunk(WireChunk *chunk, int max_bytes){
 
-    int available = 1;
-    int bytes = 0;
-    unsigned int ch_value;
+    ChunkView view;
+    int available = getChunkView(&view, max_bytes);
 
-    /* if file not opened */
-    if(!open_file){
-        available = check_for_file();
+    chunk->header.file_index = view.file_index;
+    chunk->header.chunk_index = view.chunk_index;
+    chunk->header.n_bytes = view.n_bytes;
+
+    memcpy(chunk->bytes, view.bytes, view.n_bytes);
+
+    return available;
+}
+
+/** 
+ *  \brief Wait until the next chunk can be read without blocking.
+ *
+ *  Opens the next file if needed. Mapped files are always ready, while pipes, FIFOs and the
+ *  standard input are ready once they have data, or reached their end.
+ *  
+ *  Operation carried out by the dispatcher.
+ * 
+ *  \param timeout_ms maximum time to wait, in milliseconds.
+ *  \return 1 if the next chunk is ready, 0 if the time ran out.
+ */
+
+int wait_for_input(int timeout_ms){
+
+    struct pollfd pfd;
+
+    if(!open_file && !check_for_file())
+        return 1;
+
+    if(file_data != NULL || fd == -1 || file_offset < stream_len)
+        return 1;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, timeout_ms) != 0;
+}
+
+/** 
+ *  \brief Number of bytes still to be read from all the files.
+ *  
+ *  Operation carried out by the dispatcher.
+ * 
+ *  \return number of bytes left, -1 if unknown because some file is not a regular file.
+ */
+
+long long input_bytes_left(){
+
+    long long left = 0;
+
+    for(int i = index_file + 1; i < num_files; i++){
+        if(file_sizes[i] < 0)
+            return -1;
+        left += file_sizes[i] - start_offsets[i];
     }
 
-    /* if file available */
-    if(available){
+    /* part of the current file not read yet */
+    if(open_file){
+        if(file_data != NULL)
+            left += file_size - file_offset;
+        else if(fd != -1)
+            return -1;
+    }
 
-        while (bytes != NUM_BYTES) {
+    return left;
+}
 
-            ch_value = get_int(fp);
+#if METRICS
+/**
+ *  \brief print the metrics selected at compile time of a file, as text lines or as members of its
+ *  JSON object.
+ *
+ *  \param result merged result of all the chunks of the file.
+ */
 
-            /* if EOF */
-            if(ch_value == -1){
-                break;
-            }
+static void print_metrics(const ChunkResult *result) {
 
-            /* save next byte in the structure */
-            MessageStruct->ch_values[bytes] = ch_value;
-            bytes += 1;
-        }
+  Metrics metrics;
 
-        /* avoid ending in the middle of a word */
-        while (!is_split(ch_value)) {   
+  result_metrics(result, &metrics);
 
-            ch_value = get_int(fp);
+  if (emit_json) {
+#if METRICS & METRIC_LENGTHS
+    long long n_length = 0;
 
-            /* if EOF */
-            if(ch_value == -1){
-                break;
-            }
+    for (int i = 0; i <= METRIC_MAX_LENGTH; i++)
+      n_length += metrics.lengths[i];
+
+    printf(", \"average_length\": %.4f, \"lengths\": [", n_length > 0 ? (double)metrics.length_total / n_length : 0.0);
+    for (int i = 1; i <= METRIC_MAX_LENGTH; i++)
+      printf("%s%lld", i > 1 ? ", " : "", metrics.lengths[i]);
+    printf("]");
+#endif
+#if METRICS & METRIC_CLASSES
+    printf(", \"classes\": {\"vowels\": %lld, \"consonants\": %lld, \"split\": %lld, \"apostrophes\": %lld, \"other\": %lld}",
+           metrics.classes[0], metrics.classes[1], metrics.classes[2], metrics.classes[3], metrics.classes[4]);
+#endif
+#if METRICS & METRIC_LINES
+    printf(", \"lines\": %lld", metrics.lines);
+#endif
+    return;
+  }
+
+#if METRICS & METRIC_LENGTHS
+  long long n_words = 0;
+
+  for (int i = 0; i <= METRIC_MAX_LENGTH; i++)
+    n_words += metrics.lengths[i];
+
+  printf("Average word length = %.2f \n", n_words > 0 ? (double)metrics.length_total / n_words : 0.0);
+  printf("Words by length =");
+  for (int i = 1; i <= METRIC_MAX_LENGTH; i++)
+    if (metrics.lengths[i] > 0)
+      printf(" %d%s:%lld", i, i == METRIC_MAX_LENGTH ? "+" : "", metrics.lengths[i]);
+  printf(" \n");
+#endif
+
+#if METRICS & METRIC_CLASSES
+  printf("Vowels = %lld, consonants = %lld, split chars = %lld, apostrophes = %lld, other chars = %lld \n",
+         metrics.classes[0], metrics.classes[1], metrics.classes[2], metrics.classes[3], metrics.classes[4]);
+#endif
+
+#if METRICS & METRIC_LINES
+  printf("Number of lines = %lld \n", metrics.lines);
+#endif
+}
+#endif
+
+/**
+ *  \brief print a string as a JSON string.
+ *
+ *  \param text string to be printed.
+ */
+
+static void print_json_string(const char *text) {
+
+  putchar('"');
+
+  for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\')
+      printf("\\%c", *c);
+    else if (*c < 0x20)
+      printf("\\u%04x", *c);
+    else
+      putchar(*c);
+  }
+
+  putchar('"');
+}
+
+/**
+ *  \brief print the final results of a file, as text or as a JSON line.
+ *
+ *  \param file index of the file.
+ */
+
+static void emit_file(int file) {
+
+  long long num_words, num_vowels, num_cons;
+
+  /* counters of the words merged from the chunks */
+  result_finish(&file_results[file], &num_words, &num_vowels, &num_cons);
+  array_num_words[file] += num_words;
+  array_num_vowels[file] += num_vowels;
+  array_num_cons[file] += num_cons;
+
+  /* only a file hashed from its start to its end is cached */
+  if (cache_file != NULL && (cached[file] || (start_offsets[file] == 0 && file_results[file].n_bytes == file_sizes[file]))) {
+    long long counters[3] = { array_num_words[file], array_num_vowels[file], array_num_cons[file] };
+    cache_store(file_names[file], file_hashes[file], counters);
+  }
+
+  if (emit_json) {
+    printf("{\"file\": ");
+    print_json_string(file_names[file]);
+    printf(", \"words\": %lld, \"vowels\": %lld, \"consonants\": %lld", array_num_words[file],
+           array_num_vowels[file], array_num_cons[file]);
+#if METRICS
+    print_metrics(&file_results[file]);
+#endif
+    printf("}\n");
+  }
+  else {
+    printf("File name: %s \n", file_names[file]);
+    printf("Total number of words = %lld \n", array_num_words[file]);
+    printf("N. of words beginning with a vowel = %lld \n", array_num_vowels[file]);
+    printf("N. of words ending with a consonant = %lld \n", array_num_cons[file]);
+#if METRICS
+    print_metrics(&file_results[file]);
+#endif
+    printf("\n");
+  }
+
+  emitted[file] = 1;
+}
 
-            /* save next byte in the structure */
-            MessageStruct->ch_values[bytes] = ch_value;
-            bytes += 1;
+/**
+ *  \brief print the files that are complete and not printed yet.
+ *
+ *  In completion order only the file given can have just been completed, while in argument order
+ *  the files are printed up to the first one that is not complete.
+ *
+ *  \param file index of the file whose chunks changed.
+ */
+
+static void emit_ready_files(int file) {
+
+  if (emit_when == EMIT_COMPLETION) {
+    if (!emitted[file] && file_chunks[file] >= 0 && next_chunk[file] >= file_chunks[file]) {
+      emit_file(file);
+      fflush(stdout);
+    }
+    return;
+  }
+
+  while (next_emit < num_files && file_chunks[next_emit] >= 0 && next_chunk[next_emit] >= file_chunks[next_emit]) {
+    if (!emitted[next_emit]) {
+      emit_file(next_emit);
+      fflush(stdout);
+    }
+    next_emit++;
+  }
+}
+
+/**
+ *  \brief set the number of chunks of a file, once the last one was handed out.
+ *
+ *  The file is complete once all its chunks are merged, and it is printed then if the results are
+ *  printed as the files complete.
+ *
+ *  Operation carried out by the dispatcher.
+ *
+ *  \param file index of the file.
+ *  \param n_chunks number of chunks of the file.
+ */
+
+void set_file_chunks(int file, int n_chunks) {
+
+  file_chunks[file] = n_chunks;
+
+  if (emit_when != EMIT_END)
+    emit_ready_files(file);
+}
+
+/**
+ *  \brief Save partial results of each chunk.
+ *
+ *  The results of a file are merged in the order of its chunks. A result that arrives before the
+ *  chunks that precede it waits until they are merged.
+ *
+ *  Operation carried out by the dispatcher.
+ *
+ *  \param result partial results of a chunk.
+ */
+
+void save_file_results(ChunkResult *result) {
+
+    int file = result->file_index;
+    int i;
+
+    /* wait for the chunks before it */
+    if (result->chunk_index != next_chunk[file]) {
+        if (num_pending == max_pending) {
+            max_pending = max_pending ? 2 * max_pending : 16;
+            pending_results = (ChunkResult *)realloc(pending_results, max_pending * sizeof(ChunkResult));
         }
+        pending_results[num_pending++] = *result;
+        return;
     }
 
-    /* save file index in the structure */
-    MessageStruct->file_index = index_file;
+    result_merge(&file_results[file], result, &file_results[file]);
+    next_chunk[file]++;
 
-    /* save number of bytes read */
-    MessageStruct->n_bytes_read = bytes;
+    /* merge the waiting results that are now in turn */
+    for (i = 0; i < num_pending; i++) {
+        if (pending_results[i].file_index == file && pending_results[i].chunk_index == next_chunk[file]) {
+            result_merge(&file_results[file], &pending_results[i], &file_results[file]);
+            next_chunk[file]++;
+            pending_results[i] = pending_results[--num_pending];
+            i = -1;
+        }
+    }
 
-    /* if 0 bytes are read, is EOF */
-    if(bytes == 0){
-        check_close_file();
+    /* print the file once its last chunk is merged */
+    if (emit_when != EMIT_END)
+        emit_ready_files(file);
+
+    /* no chunk of the file is left to process in place */
+    if (file_maps[file] != NULL && next_chunk[file] == file_chunks[file]) {
+        munmap(file_maps[file], file_map_sizes[file]);
+        file_maps[file] = NULL;
     }
 
-    return available;
+    /* save the progress every journal_interval seconds */
+    if (journal_name != NULL) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if ((now.tv_sec - journal_time.tv_sec) + (now.tv_nsec - journal_time.tv_nsec) / 1000000000.0 >= journal_interval)
+            write_journal();
+    }
 }
 
 /**
- *  \brief Save partial results of each chunk.
+ *  \brief add counters gathered apart from the chunk results to the totals of a file.
  *
  *  Operation carried out by the dispatcher.
  *
- *  \param messageStruct message structure to save.
+ *  \param file index of the file.
+ *  \param num_words number of words.
+ *  \param num_vowels number of words beginning with a vowel.
+ *  \param num_cons number of words ending with a consonant.
  */
 
-void save_file_results(MessageStruct *messageStruct) {
-    array_num_words[messageStruct->file_index] += messageStruct->num_words;
-    array_num_vowels[messageStruct->file_index] += messageStruct->num_vowels;
-    array_num_cons[messageStruct->file_index] += messageStruct->num_cons;
+void add_file_counters(int file, long long num_words, long long num_vowels, long long num_cons) {
+  array_num_words[file] += num_words;
+  array_num_vowels[file] += num_vowels;
+  array_num_cons[file] += num_cons;
 }
 
 /**
- *  \brief print final results.
+ *  \brief print the totals of all the text counted so far.
+ *
+ *  The results of the chunks that are still being processed, or that wait for an earlier chunk,
+ *  are left out, and a word that is still going on is counted as if the text ended there.
  *
  *  Operation carried out by the dispatcher.
+ *
+ *  \param bytes_read number of bytes read so far.
  */
 
-void print_final_results() {
+void print_rolling_results(long long bytes_read) {
+
+  long long num_words, num_vowels, num_cons;
+  long long total_words = 0, total_vowels = 0, total_cons = 0;
+
   for (int i = 0; i < num_files; i++) {
-    printf("File name: %s \n", file_names[i]);
-    printf("Total number of words = %d \n", array_num_words[i]);
-    printf("N. of words beginning with a vowel = %d \n", array_num_vowels[i]);
-    printf("N. of words ending with a consonant = %d \n\n", array_num_cons[i]);
+    result_finish(&file_results[i], &num_words, &num_vowels, &num_cons);
+    total_words += num_words;
+    total_vowels += num_vowels;
+    total_cons += num_cons;
   }
+
+  printf("Bytes read = %lld, total number of words = %lld, beginning with a vowel = %lld, ending with a consonant = %lld \n",
+         bytes_read, total_words, total_vowels, total_cons);
+  fflush(stdout);
+}
+
+/**
+ *  \brief print final results.
+ *
+ *  Operation carried out by the dispatcher.
+ */
+
+void print_final_results() {
+
+  if (journal_name != NULL)
+    write_journal();
+
+  /* the files not printed yet, in argument order */
+  for (int i = 0; i < num_files; i++)
+    if (!emitted[i])
+      emit_file(i);
+
+  cache_save();
+}
+
+/**
+ *  \brief print the elapsed time.
+ *
+ *  Operation carried out by the dispatcher, after the final results.
+ *
+ *  \param start time the processing started.
+ *  \param finish time the processing finished.
+ */
+
+void print_elapsed(struct timespec start, struct timespec finish) {
+
+  printf ("\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
 }
\ No newline at end of file
@@ -4,22 +4,56 @@
  *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
  *
  *  Definition of the operations carried out by the dispatcher:
+ *     \li set_journal
+ *     \li set_cache
+ *     \li set_output
+ *     \li keep_file_maps
  *     \li allocateMemory
  *     \li check_for_file
  *     \li check_close_file
- *     \li get_int
- *     \li getVal
+ *     \li getChunkView
+ *     \li getChunk
+ *     \li wait_for_input
+ *     \li input_bytes_left
+ *     \li set_file_chunks
  *     \li save_file_results
+ *     \li add_file_counters
+ *     \li print_rolling_results
  *     \li print_final_results
+ *     \li print_elapsed
  *
  *  \author Eduardo Santos and Pedro Bastos - May 2022
  */
 
+#include <pthread.h>
+#include <time.h>
+
 #include "MessageStruct.h"
 
 #ifndef DISPATCHER
 #define DISPATCHER
 
+/** \brief view of a chunk inside the input buffers of the dispatcher */
+typedef struct{
+    int file_index;
+    int chunk_index;
+    const unsigned char *bytes;
+    int n_bytes;
+    int stable;                     /* 1 if the bytes stay valid until the chunks of the file are merged */
+} ChunkView;
+
+/** \brief Keep a progress journal, and resume from it */
+extern void set_journal(const char *name, double interval, int resume);
+
+/** \brief Keep a result cache */
+extern void set_cache(const char *name);
+
+/** \brief Choose when and how the results of each file are printed */
+extern void set_output(int when, int json);
+
+/** \brief Keep the mapped files until all their chunks are merged, by threads that merge under a lock */
+extern void keep_file_maps(pthread_mutex_t *lock);
+
 /** \brief Allocate memory to save final results */
 extern void allocateMemory(char *filenames[], unsigned int numfiles);
 
@@ -29,16 +63,34 @@ extern int check_for_file();
 /** \brief close file */
 extern void check_close_file();
 
-/** \brief convert char to integer */
-int get_int(FILE *fp);
+/** \brief get a view of the next chunk, without copying it */
+extern int getChunkView(ChunkView *view, int max_bytes);
 
 /** \brief read next chunk to send to workers */
-extern int getVal(MessageStruct *MessageStruct);
+extern int getChunk(WireChunk *chunk, int max_bytes);
+
+/** \brief wait until the next chunk can be read without blocking */
+extern int wait_for_input(int timeout_ms);
+
+/** \brief number of bytes still to be read, -1 if unknown */
+extern long long input_bytes_left();
+
+/** \brief set the number of chunks of a file, once the last one was handed out */
+extern void set_file_chunks(int file, int n_chunks);
 
 /** \brief save partial results */
-extern void save_file_results(MessageStruct *messageStruct);
+extern void save_file_results(ChunkResult *result);
+
+/** \brief add counters gathered apart from the chunk results */
+extern void add_file_counters(int file, long long num_words, long long num_vowels, long long num_cons);
+
+/** \brief print the totals of the text counted so far */
+extern void print_rolling_results(long long bytes_read);
 
 /** \brief print final results */
 extern void print_final_results();
 
+/** \brief print the elapsed time */
+extern void print_elapsed(struct timespec start, struct timespec finish);
+
 #endif
\ No newline at end of file
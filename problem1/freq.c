@@ -0,0 +1,813 @@
+/**
+ *  \file freq.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Word frequency mode. The chunks are handed out round-robin, one at a time.
+ *  Each worker splits its chunks into words with the same split chars as the counters, and adds
+ *  the words that lie inside a chunk to a local open addressing hash table. The bytes before the
+ *  first split char and after the last one may belong to words cut between chunks, so they are
+ *  gathered by the root, which joins them in chunk order and counts those words.
+ *
+ *  Every table is then partitioned by the hash of its words and exchanged with MPI_Alltoallv, so
+ *  each worker owns a shard of the vocabulary with the final counts of its words. The workers send
+ *  the TOP_K most frequent words of every file in their shard to the root, which merges them.
+ *
+ *  Words are lower cased, their leading apostrophes dropped and the typographic apostrophes
+ *  replaced by "'". Words longer than FREQ_MAX_WORD bytes are cut.
+ *
+ *  Definition of the operations:
+ *     \li freq_dispatcher
+ *     \li freq_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "utf8.h"
+#include "localReduce.h"
+#include "freq.h"
+
+/** \brief word of a hash table */
+typedef struct {
+  uint64_t hash;
+  long long count;
+  int file_index;
+  int key_len;
+  size_t key_offset;
+} WordEntry;
+
+/** \brief open addressing hash table of the words of all files, with linear probing */
+typedef struct {
+  WordEntry *entries;
+  int capacity;
+  int size;
+  unsigned char *keys;
+  size_t keys_len;
+  size_t keys_cap;
+} WordTable;
+
+/** \brief word and its count, pointing to its bytes */
+typedef struct {
+  int file_index;
+  int key_len;
+  long long count;
+  const unsigned char *key;
+} WordCount;
+
+/** \brief bytes of a chunk that may belong to words cut between chunks */
+typedef struct {
+  int file_index;
+  int chunk_index;
+  int has_split;                  /* 0 if the whole chunk is part of a single piece of text without split chars */
+  int head_len;                   /* bytes before the first split char */
+  int tail_len;                   /* bytes after the last split char */
+  int offset;                     /* offset of the head bytes, followed by the tail bytes */
+} Fragment;
+
+/** \brief state of a worker */
+typedef struct {
+  WordTable table;
+  Fragment *fragments;
+  int n_fragments;
+  int max_fragments;
+  unsigned char *bytes;
+  int n_bytes;
+  int max_bytes;
+} FreqWorker;
+
+/** \brief size of the header of a word in the packed buffers: file index, length and count */
+#define PACKED_HEADER   (2 * sizeof(int) + sizeof(long long))
+
+/**
+ *  \brief Initialize an empty hash table.
+ *
+ *  \param table hash table.
+ *  \param capacity initial number of entries, a power of two.
+ */
+
+static void table_init(WordTable *table, int capacity) {
+  table->entries = calloc(capacity, sizeof(WordEntry));
+  table->capacity = capacity;
+  table->size = 0;
+  table->keys = malloc(capacity * 8);
+  table->keys_len = 0;
+  table->keys_cap = capacity * 8;
+}
+
+/**
+ *  \brief Free a hash table.
+ *
+ *  \param table hash table.
+ */
+
+static void table_free(WordTable *table) {
+  free(table->entries);
+  free(table->keys);
+}
+
+/**
+ *  \brief FNV-1a hash of a word of a file.
+ *
+ *  \param file_index index of the file.
+ *  \param key bytes of the word.
+ *  \param key_len number of bytes of the word.
+ *  \return hash of the word.
+ */
+
+static uint64_t word_hash(int file_index, const unsigned char *key, int key_len) {
+
+  uint64_t hash = 14695981039346656037ULL ^ (uint64_t)file_index;
+
+  for (int i = 0; i < key_len; i++) {
+    hash ^= key[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/**
+ *  \brief Double the number of entries of a hash table.
+ *
+ *  \param table hash table.
+ */
+
+static void table_grow(WordTable *table) {
+
+  WordEntry *old = table->entries;
+  int old_capacity = table->capacity;
+
+  table->capacity *= 2;
+  table->entries = calloc(table->capacity, sizeof(WordEntry));
+
+  for (int i = 0; i < old_capacity; i++) {
+    if (old[i].count == 0)
+      continue;
+
+    int slot = old[i].hash & (table->capacity - 1);
+    while (table->entries[slot].count != 0)
+      slot = (slot + 1) & (table->capacity - 1);
+    table->entries[slot] = old[i];
+  }
+
+  free(old);
+}
+
+/**
+ *  \brief Add occurrences of a word of a file to a hash table.
+ *
+ *  \param table hash table.
+ *  \param file_index index of the file.
+ *  \param key bytes of the word.
+ *  \param key_len number of bytes of the word.
+ *  \param count number of occurrences.
+ */
+
+static void table_add(WordTable *table, int file_index, const unsigned char *key, int key_len, long long count) {
+
+  uint64_t hash = word_hash(file_index, key, key_len);
+  int slot = hash & (table->capacity - 1);
+  WordEntry *entry;
+
+  while ((entry = &table->entries[slot])->count != 0) {
+    if (entry->hash == hash && entry->file_index == file_index && entry->key_len == key_len &&
+        memcmp(table->keys + entry->key_offset, key, key_len) == 0) {
+      entry->count += count;
+      return;
+    }
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+
+  /* new word */
+  if (table->keys_len + key_len > table->keys_cap) {
+    while (table->keys_len + key_len > table->keys_cap)
+      table->keys_cap *= 2;
+    table->keys = realloc(table->keys, table->keys_cap);
+  }
+
+  memcpy(table->keys + table->keys_len, key, key_len);
+  entry->hash = hash;
+  entry->count = count;
+  entry->file_index = file_index;
+  entry->key_len = key_len;
+  entry->key_offset = table->keys_len;
+  table->keys_len += key_len;
+
+  /* keep the load under 70% */
+  if (++table->size * 10 > table->capacity * 7)
+    table_grow(table);
+}
+
+/**
+ *  \brief Lower case form of a Latin-1 letter.
+ *
+ *  \param ch_value character value.
+ *  \return lower case character value.
+ */
+
+static int fold_case(int ch_value) {
+
+  if (ch_value >= 'A' && ch_value <= 'Z')
+    return ch_value + 32;
+
+  if (ch_value >= 192 && ch_value <= 222 && ch_value != 215)
+    return ch_value + 32;
+
+  return ch_value;
+}
+
+/**
+ *  \brief Split a piece of text into words and count them.
+ *
+ *  The piece must start after a split char, or at the start of a file, and end before a split
+ *  char, or at the end of a file.
+ *
+ *  \param bytes piece of UTF-8 encoded text.
+ *  \param n_bytes number of bytes of the piece.
+ *  \param file_index index of the file.
+ *  \param table hash table where the words are counted.
+ */
+
+static void count_words(const unsigned char *bytes, int n_bytes, int file_index, WordTable *table) {
+
+  unsigned char word[FREQ_MAX_WORD];
+  unsigned char encoded[4];
+  int len = 0, n;
+  int pos = 0;
+  int ch_value, ch_class;
+  bool full = false;
+
+  while (pos < n_bytes) {
+
+    if ((ch_value = utf8_decode(bytes, n_bytes, &pos)) < 0)
+      break;
+
+    ch_class = char_class(ch_value);
+
+    /* end of word */
+    if (ch_class & CLASS_SPLIT) {
+      if (len > 0)
+        table_add(table, file_index, word, len, 1);
+      len = 0;
+      full = false;
+      continue;
+    }
+
+    /* apostrophes only belong to a word after its first char */
+    if (ch_class & CLASS_APOSTROPHE) {
+      if (len == 0)
+        continue;
+      ch_value = '\'';
+    }
+    else
+      ch_value = fold_case(ch_value);
+
+    n = utf8_encode(ch_value, encoded);
+
+    if (full || len + n > FREQ_MAX_WORD)
+      full = true;
+    else {
+      memcpy(word + len, encoded, n);
+      len += n;
+    }
+  }
+
+  if (len > 0)
+    table_add(table, file_index, word, len, 1);
+}
+
+/**
+ *  \brief Find the first and the last split chars of a chunk.
+ *
+ *  \param bytes chunk of UTF-8 encoded text, cut at any byte.
+ *  \param n_bytes number of bytes in the chunk.
+ *  \param head_end offset of the first split char.
+ *  \param tail_start offset right after the last split char.
+ *  \return 1 if the chunk has a split char, 0 otherwise.
+ */
+
+static int find_splits(const unsigned char *bytes, int n_bytes, int *head_end, int *tail_start) {
+
+  int pos = 0, at;
+  int ch_value;
+  int found = 0;
+
+  while (pos < n_bytes) {
+    at = pos;
+
+    if ((ch_value = utf8_decode(bytes, n_bytes, &pos)) < 0)
+      break;
+
+    if (is_split(ch_value)) {
+      if (!found)
+        *head_end = at;
+      *tail_start = pos;
+      found = 1;
+    }
+  }
+
+  return found;
+}
+
+/**
+ *  \brief Count the words that lie inside a chunk and keep the bytes at its ends.
+ *
+ *  \param chunk chunk received.
+ *  \param arg state of the worker.
+ */
+
+static void freq_chunk(const WireChunk *chunk, void *arg) {
+
+  FreqWorker *worker = (FreqWorker *)arg;
+  Fragment *fragment;
+  int n_bytes = chunk->header.n_bytes;
+  int head_end = n_bytes, tail_start = n_bytes;
+  int has_split = find_splits(chunk->bytes, n_bytes, &head_end, &tail_start);
+
+  if (has_split)
+    count_words(chunk->bytes + head_end, tail_start - head_end, chunk->header.file_index, &worker->table);
+
+  if (worker->n_fragments == worker->max_fragments) {
+    worker->max_fragments = worker->max_fragments ? 2 * worker->max_fragments : 1024;
+    worker->fragments = realloc(worker->fragments, worker->max_fragments * sizeof(Fragment));
+  }
+
+  fragment = &worker->fragments[worker->n_fragments++];
+  fragment->file_index = chunk->header.file_index;
+  fragment->chunk_index = chunk->header.chunk_index;
+  fragment->has_split = has_split;
+  fragment->head_len = head_end;
+  fragment->tail_len = n_bytes - tail_start;
+  fragment->offset = worker->n_bytes;
+
+  if (worker->n_bytes + fragment->head_len + fragment->tail_len > worker->max_bytes) {
+    while (worker->n_bytes + fragment->head_len + fragment->tail_len > worker->max_bytes)
+      worker->max_bytes = worker->max_bytes ? 2 * worker->max_bytes : 64 * 1024;
+    worker->bytes = realloc(worker->bytes, worker->max_bytes);
+  }
+
+  memcpy(worker->bytes + worker->n_bytes, chunk->bytes, fragment->head_len);
+  memcpy(worker->bytes + worker->n_bytes + fragment->head_len, chunk->bytes + tail_start, fragment->tail_len);
+  worker->n_bytes += fragment->head_len + fragment->tail_len;
+}
+
+/**
+ *  \brief Order the fragments by file and chunk.
+ */
+
+static int compare_fragments(const void *a, const void *b) {
+
+  const Fragment *left = (const Fragment *)a;
+  const Fragment *right = (const Fragment *)b;
+
+  if (left->file_index != right->file_index)
+    return left->file_index < right->file_index ? -1 : 1;
+
+  return (left->chunk_index > right->chunk_index) - (left->chunk_index < right->chunk_index);
+}
+
+/**
+ *  \brief Order the words by file, then by decreasing count, then by their bytes.
+ */
+
+static int compare_counts(const void *a, const void *b) {
+
+  const WordCount *left = (const WordCount *)a;
+  const WordCount *right = (const WordCount *)b;
+  int len = left->key_len < right->key_len ? left->key_len : right->key_len;
+  int cmp;
+
+  if (left->file_index != right->file_index)
+    return left->file_index < right->file_index ? -1 : 1;
+
+  if (left->count != right->count)
+    return left->count > right->count ? -1 : 1;
+
+  if ((cmp = memcmp(left->key, right->key, len)) != 0)
+    return cmp;
+
+  return left->key_len - right->key_len;
+}
+
+/**
+ *  \brief Gather the fragments of all the workers.
+ *
+ *  On the root the fragments are sorted by file and chunk, with their offsets into the gathered
+ *  bytes. The workers only send theirs.
+ *
+ *  \param worker state of this process, whose fragments are replaced on the root.
+ */
+
+static void gather_fragments(FreqWorker *worker) {
+
+  int rank, size;
+  int *counts = NULL, *displs = NULL, *byte_counts = NULL, *byte_displs = NULL;
+  int n_fragments = 0, n_bytes = 0;
+  Fragment *fragments = NULL;
+  unsigned char *bytes = NULL;
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  if (rank == 0) {
+    counts = malloc(size * sizeof(int));
+    displs = malloc(size * sizeof(int));
+    byte_counts = malloc(size * sizeof(int));
+    byte_displs = malloc(size * sizeof(int));
+  }
+
+  MPI_Gather(&worker->n_fragments, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Gather(&worker->n_bytes, 1, MPI_INT, byte_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (rank == 0) {
+    for (int i = 0; i < size; i++) {
+      displs[i] = n_fragments * sizeof(Fragment);
+      n_fragments += counts[i];
+      counts[i] *= sizeof(Fragment);
+      byte_displs[i] = n_bytes;
+      n_bytes += byte_counts[i];
+    }
+
+    fragments = malloc((n_fragments > 0 ? n_fragments : 1) * sizeof(Fragment));
+    bytes = malloc(n_bytes > 0 ? n_bytes : 1);
+  }
+
+  MPI_Gatherv(worker->fragments, worker->n_fragments * sizeof(Fragment), MPI_BYTE, fragments, counts, displs,
+              MPI_BYTE, 0, MPI_COMM_WORLD);
+  MPI_Gatherv(worker->bytes, worker->n_bytes, MPI_BYTE, bytes, byte_counts, byte_displs, MPI_BYTE, 0,
+              MPI_COMM_WORLD);
+
+  if (rank == 0) {
+
+    /* offsets into the gathered bytes */
+    for (int i = 0, f = 0; i < size; i++)
+      for (int j = 0; j < (int)(counts[i] / sizeof(Fragment)); j++, f++)
+        fragments[f].offset += byte_displs[i];
+
+    qsort(fragments, n_fragments, sizeof(Fragment), compare_fragments);
+
+    free(worker->fragments);
+    free(worker->bytes);
+    worker->fragments = fragments;
+    worker->n_fragments = n_fragments;
+    worker->bytes = bytes;
+    worker->n_bytes = n_bytes;
+
+    free(counts);
+    free(displs);
+    free(byte_counts);
+    free(byte_displs);
+  }
+}
+
+/**
+ *  \brief Join the fragments in chunk order and count the words cut between chunks.
+ *
+ *  Operation carried out by the root.
+ *
+ *  \param worker state of the root, with the fragments of all the chunks.
+ */
+
+static void count_fragments(FreqWorker *worker) {
+
+  unsigned char *piece = NULL;
+  int len = 0, max_len = 0;
+  int file = -1;
+
+  for (int i = 0; i < worker->n_fragments; i++) {
+
+    Fragment *fragment = &worker->fragments[i];
+    const unsigned char *head = worker->bytes + fragment->offset;
+
+    /* the text left at the end of a file is its last piece */
+    if (fragment->file_index != file) {
+      count_words(piece, len, file, &worker->table);
+      file = fragment->file_index;
+      len = 0;
+    }
+
+    if (len + fragment->head_len > max_len) {
+      max_len = 2 * (len + fragment->head_len);
+      piece = realloc(piece, max_len);
+    }
+
+    memcpy(piece + len, head, fragment->head_len);
+    len += fragment->head_len;
+
+    /* a split char ends the piece, and its tail starts the next one */
+    if (fragment->has_split) {
+      count_words(piece, len, file, &worker->table);
+
+      if (fragment->tail_len > max_len) {
+        max_len = 2 * fragment->tail_len;
+        piece = realloc(piece, max_len);
+      }
+
+      memcpy(piece, head + fragment->head_len, fragment->tail_len);
+      len = fragment->tail_len;
+    }
+  }
+
+  count_words(piece, len, file, &worker->table);
+
+  free(piece);
+}
+
+/**
+ *  \brief Pack a word into a buffer.
+ *
+ *  \param buffer position in the buffer.
+ *  \param word word to be packed.
+ *  \return position after the word.
+ */
+
+static unsigned char *pack_word(unsigned char *buffer, const WordCount *word) {
+  memcpy(buffer, &word->file_index, sizeof(int));
+  memcpy(buffer + sizeof(int), &word->key_len, sizeof(int));
+  memcpy(buffer + 2 * sizeof(int), &word->count, sizeof(long long));
+  memcpy(buffer + PACKED_HEADER, word->key, word->key_len);
+  return buffer + PACKED_HEADER + word->key_len;
+}
+
+/**
+ *  \brief Unpack a word from a buffer.
+ *
+ *  \param buffer position in the buffer.
+ *  \param word word unpacked, pointing to its bytes in the buffer.
+ *  \return position after the word.
+ */
+
+static const unsigned char *unpack_word(const unsigned char *buffer, WordCount *word) {
+  memcpy(&word->file_index, buffer, sizeof(int));
+  memcpy(&word->key_len, buffer + sizeof(int), sizeof(int));
+  memcpy(&word->count, buffer + 2 * sizeof(int), sizeof(long long));
+  word->key = buffer + PACKED_HEADER;
+  return buffer + PACKED_HEADER + word->key_len;
+}
+
+/**
+ *  \brief Exchange the words of all the tables, so each worker gets the shard of the vocabulary
+ *  whose hashes map to it.
+ *
+ *  \param table hash table of this process, whose words are sent away.
+ *  \param shard hash table that receives the words of the shard of this process.
+ */
+
+static void shuffle_words(const WordTable *table, WordTable *shard) {
+
+  int size;
+  WordCount word;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  int *send_counts = calloc(size, sizeof(int));
+  int *send_displs = malloc(size * sizeof(int));
+  int *recv_counts = malloc(size * sizeof(int));
+  int *recv_displs = malloc(size * sizeof(int));
+  int send_total = 0, recv_total = 0;
+
+  /* the root owns no shard */
+  for (int i = 0; i < table->capacity; i++)
+    if (table->entries[i].count != 0)
+      send_counts[1 + table->entries[i].hash % (size - 1)] += PACKED_HEADER + table->entries[i].key_len;
+
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+
+  for (int i = 0; i < size; i++) {
+    send_displs[i] = send_total;
+    send_total += send_counts[i];
+    recv_displs[i] = recv_total;
+    recv_total += recv_counts[i];
+  }
+
+  unsigned char *send_buffer = malloc(send_total > 0 ? send_total : 1);
+  unsigned char *recv_buffer = malloc(recv_total > 0 ? recv_total : 1);
+  int *fill = malloc(size * sizeof(int));
+
+  memcpy(fill, send_displs, size * sizeof(int));
+
+  for (int i = 0; i < table->capacity; i++) {
+    const WordEntry *entry = &table->entries[i];
+
+    if (entry->count == 0)
+      continue;
+
+    int dest = 1 + entry->hash % (size - 1);
+
+    word.file_index = entry->file_index;
+    word.key_len = entry->key_len;
+    word.count = entry->count;
+    word.key = table->keys + entry->key_offset;
+    fill[dest] = pack_word(send_buffer + fill[dest], &word) - send_buffer;
+  }
+
+  MPI_Alltoallv(send_buffer, send_counts, send_displs, MPI_BYTE, recv_buffer, recv_counts, recv_displs, MPI_BYTE,
+                MPI_COMM_WORLD);
+
+  for (const unsigned char *pos = recv_buffer; pos < recv_buffer + recv_total; ) {
+    pos = unpack_word(pos, &word);
+    table_add(shard, word.file_index, word.key, word.key_len, word.count);
+  }
+
+  free(send_counts);
+  free(send_displs);
+  free(recv_counts);
+  free(recv_displs);
+  free(send_buffer);
+  free(recv_buffer);
+  free(fill);
+}
+
+/**
+ *  \brief freq dispatcher.
+ *
+ *  Hands out the chunks round-robin, counts the words cut between chunks, sends them to their
+ *  shards and prints the most frequent words of every file.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks.
+ *  \param top_k number of words printed for every file.
+ */
+
+void freq_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes, int top_k) {
+
+  struct timespec start, finish;
+  int size;
+  int files = num_files;
+  FreqWorker root = { .fragments = NULL, .n_fragments = 0, .max_fragments = 0, .bytes = NULL, .n_bytes = 0,
+                      .max_bytes = 0 };
+  WordTable shard;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  /* the workers need the number of files for their counters */
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  round_robin_send(chunk_bytes, 1);
+
+  /* words cut between chunks */
+  table_init(&root.table, 1024);
+  gather_fragments(&root);
+  count_fragments(&root);
+
+  table_init(&shard, 16);
+  shuffle_words(&root.table, &shard);
+
+  /* number of distinct words of every file */
+  long long *distinct = calloc(files, sizeof(long long));
+  MPI_Reduce(MPI_IN_PLACE, distinct, files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  /* most frequent words of every shard */
+  int *counts = malloc(size * sizeof(int));
+  int *displs = malloc(size * sizeof(int));
+  int zero = 0, total = 0, n_words = 0;
+
+  MPI_Gather(&zero, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  for (int i = 0; i < size; i++) {
+    displs[i] = total;
+    total += counts[i];
+  }
+
+  unsigned char *buffer = malloc(total > 0 ? total : 1);
+  MPI_Gatherv(NULL, 0, MPI_BYTE, buffer, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  for (const unsigned char *pos = buffer; pos < buffer + total; n_words++)
+    pos += PACKED_HEADER + ((const int *)(const void *)pos)[1];
+
+  WordCount *words = malloc((n_words > 0 ? n_words : 1) * sizeof(WordCount));
+  const unsigned char *pos = buffer;
+
+  for (int i = 0; i < n_words; i++)
+    pos = unpack_word(pos, &words[i]);
+
+  qsort(words, n_words, sizeof(WordCount), compare_counts);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  /* print the most frequent words of every file */
+  for (int i = 0, w = 0; i < files; i++) {
+
+    printf("File name: %s \n", file_names[i]);
+    printf("Number of distinct words = %lld \n", distinct[i]);
+    printf("Most frequent words:\n");
+
+    for (int k = 0; w < n_words && words[w].file_index == i; k++, w++)
+      if (k < top_k)
+        printf("  %.*s = %lld \n", words[w].key_len, words[w].key, words[w].count);
+
+    printf("\n");
+  }
+
+  table_free(&root.table);
+  table_free(&shard);
+  free(root.fragments);
+  free(root.bytes);
+  free(distinct);
+  free(counts);
+  free(displs);
+  free(buffer);
+  free(words);
+
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief freq worker.
+ *
+ *  Counts the words of its chunks, takes part in the exchange of the words and sends the most
+ *  frequent words of its shard to the root.
+ *
+ *  \param rank worker id.
+ *  \param chunk_bytes size of the chunks.
+ *  \param top_k number of words printed for every file.
+ */
+
+void freq_worker(int rank, int chunk_bytes, int top_k) {
+
+  int files;
+  FreqWorker worker = { .fragments = NULL, .n_fragments = 0, .max_fragments = 0, .bytes = NULL, .n_bytes = 0,
+                        .max_bytes = 0 };
+  WordTable shard;
+
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  table_init(&worker.table, 1024);
+
+  round_robin_receive(chunk_bytes, freq_chunk, &worker);
+
+  gather_fragments(&worker);
+
+  table_init(&shard, 1024);
+  shuffle_words(&worker.table, &shard);
+  table_free(&worker.table);
+
+  /* words of the shard, sorted by file and count */
+  WordCount *words = malloc((shard.size > 0 ? shard.size : 1) * sizeof(WordCount));
+  long long *distinct = calloc(files, sizeof(long long));
+  int n_words = 0;
+
+  for (int i = 0; i < shard.capacity; i++) {
+    const WordEntry *entry = &shard.entries[i];
+
+    if (entry->count == 0)
+      continue;
+
+    words[n_words].file_index = entry->file_index;
+    words[n_words].key_len = entry->key_len;
+    words[n_words].count = entry->count;
+    words[n_words].key = shard.keys + entry->key_offset;
+    distinct[entry->file_index]++;
+    n_words++;
+  }
+
+  qsort(words, n_words, sizeof(WordCount), compare_counts);
+
+  MPI_Reduce(distinct, NULL, files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  /* the first top_k words of every file */
+  int total = 0;
+  for (int i = 0, k = 0; i < n_words; i++) {
+    k = (i > 0 && words[i].file_index == words[i - 1].file_index) ? k + 1 : 0;
+    if (k < top_k)
+      total += PACKED_HEADER + words[i].key_len;
+  }
+
+  unsigned char *buffer = malloc(total > 0 ? total : 1);
+  unsigned char *pos = buffer;
+
+  for (int i = 0, k = 0; i < n_words; i++) {
+    k = (i > 0 && words[i].file_index == words[i - 1].file_index) ? k + 1 : 0;
+    if (k < top_k)
+      pos = pack_word(pos, &words[i]);
+  }
+
+  MPI_Gather(&total, 1, MPI_INT, NULL, 0, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Gatherv(buffer, total, MPI_BYTE, NULL, NULL, NULL, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  table_free(&shard);
+  free(worker.fragments);
+  free(worker.bytes);
+  free(words);
+  free(distinct);
+  free(buffer);
+}
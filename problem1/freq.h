@@ -0,0 +1,23 @@
+/**
+ *  \file freq.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the word frequency mode, where the workers count how many times
+ *  each word occurs and the most frequent words of every file are printed:
+ *     \li freq_dispatcher
+ *     \li freq_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef FREQ_H_
+#define FREQ_H_
+
+/** \brief Hand out the chunks, settle the words cut between them and print the most frequent words */
+extern void freq_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes, int top_k);
+
+/** \brief Count the words of the chunks received and own a shard of the vocabulary */
+extern void freq_worker(int rank, int chunk_bytes, int top_k);
+
+#endif /* FREQ_H_ */
@@ -0,0 +1,385 @@
+/**
+ *  \file hybrid.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Hybrid mode, meant to run one rank per node or per socket. The root hands out large chunks
+ *  (HYBRID_BYTES by default) on demand and every worker rank splits them across a team of threads. Only the
+ *  main thread of a worker calls MPI, so MPI_THREAD_FUNNELED is enough. The slices of a chunk are
+ *  cut at any byte and their partial results are merged in order before being sent back.
+ *
+ *  Definition of the operations:
+ *     \li hybrid_dispatcher
+ *     \li hybrid_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "partialResult.h"
+#include "hybrid.h"
+
+/** \brief tag of the chunk headers */
+#define TAG_HEADER   0
+
+/** \brief tag of the chunk bytes */
+#define TAG_BYTES    1
+
+/** \brief team of threads of a worker rank */
+typedef struct {
+  int n_threads;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t work_ready;
+  pthread_cond_t work_done;
+  int generation;
+  int pending;
+  bool stop;
+  const unsigned char *bytes;
+  int n_bytes;
+  int n_slices;
+  ChunkResult *results;
+} ThreadTeam;
+
+/** \brief argument of each thread of the team */
+typedef struct {
+  ThreadTeam *team;
+  int id;
+} TeamMember;
+
+/**
+ *  \brief Read the next large chunk and post it to a worker, without waiting for the transfer.
+ *
+ *  Each worker owns a ring of MAX_IN_FLIGHT send buffers, and returns its results in the order it
+ *  received the chunks, so when a result arrives the oldest buffer of that worker is free.
+ *
+ *  \param worker_id worker to send the chunk to.
+ *  \param headers headers of the send buffers of all workers.
+ *  \param buffers send buffers of all workers, chunk_bytes each.
+ *  \param requests pending send requests, two for each buffer.
+ *  \param next_slot next buffer to be used by each worker.
+ *  \param chunk_bytes size of the chunks.
+ *  \return true if a chunk was sent, false if there is no more data to read.
+ */
+
+static bool post_large_chunk(int worker_id, ChunkHeader *headers, unsigned char *buffers, MPI_Request *requests,
+                             int *next_slot, int chunk_bytes) {
+
+  ChunkView view;
+  int slot = (worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1];
+  unsigned char *buffer = buffers + (size_t)slot * chunk_bytes;
+
+  /* make sure the previous transfer from this buffer is over */
+  MPI_Waitall(2, &requests[2 * slot], MPI_STATUSES_IGNORE);
+
+  if(!getChunkView(&view, chunk_bytes))
+    return false;
+
+  /* the view may not outlive the next read, so it is copied to the buffer of the slot */
+  memcpy(buffer, view.bytes, view.n_bytes);
+  headers[slot].file_index = view.file_index;
+  headers[slot].chunk_index = view.chunk_index;
+  headers[slot].n_bytes = view.n_bytes;
+
+  MPI_Isend(&headers[slot], sizeof(ChunkHeader), MPI_BYTE, worker_id, TAG_HEADER, MPI_COMM_WORLD, &requests[2 * slot]);
+  MPI_Isend(buffer, view.n_bytes, MPI_BYTE, worker_id, TAG_BYTES, MPI_COMM_WORLD, &requests[2 * slot + 1]);
+
+  next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+
+  return true;
+}
+
+/**
+ *  \brief hybrid dispatcher.
+ *
+ *  Demand-driven, as the dynamic dispatcher, but with chunks large enough to be shared by all the
+ *  threads of a worker. The end of the work is signalled with a header whose size is -1 on every
+ *  buffer of each worker.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void hybrid_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int n_workers, n_slots;
+  int in_flight = 0;
+  bool data_left = true;
+  MPI_Status status;
+
+  /* structure to receive partial results */
+  ChunkResult result;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &n_workers);
+  n_workers -= 1;
+  n_slots = n_workers * MAX_IN_FLIGHT;
+
+  /* send buffers and requests of every worker */
+  ChunkHeader *headers = malloc(n_slots * sizeof(ChunkHeader));
+  unsigned char *buffers = malloc((size_t)n_slots * chunk_bytes);
+  MPI_Request *requests = malloc(2 * n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_workers, sizeof(int));
+
+  for(int i = 0; i < 2 * n_slots; i++)
+    requests[i] = MPI_REQUEST_NULL;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  /* fill the queue of every worker */
+  for(int depth = 0; depth < MAX_IN_FLIGHT && data_left; depth++){
+    for(int worker_id = 1; worker_id <= n_workers && data_left; worker_id++){
+      data_left = post_large_chunk(worker_id, headers, buffers, requests, next_slot, chunk_bytes);
+      if(data_left)
+        in_flight++;
+    }
+  }
+
+  /* collect results from whichever worker finishes first and give it more work */
+  while(in_flight > 0){
+
+    MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    in_flight--;
+
+    /* save results of the chunk */
+    save_file_results(&result);
+
+    if(data_left){
+      data_left = post_large_chunk(status.MPI_SOURCE, headers, buffers, requests, next_slot, chunk_bytes);
+      if(data_left)
+        in_flight++;
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  MPI_Waitall(2 * n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal workers that there is no more work to be done, on every buffer */
+  for(int slot = 0; slot < n_slots; slot++){
+    headers[slot].n_bytes = -1;
+    MPI_Send(&headers[slot], sizeof(ChunkHeader), MPI_BYTE, slot / MAX_IN_FLIGHT + 1, TAG_HEADER, MPI_COMM_WORLD);
+  }
+
+  free(headers);
+  free(buffers);
+  free(requests);
+  free(next_slot);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief Process the slice of the current chunk that belongs to a thread.
+ *
+ *  \param team team of threads.
+ *  \param id index of the thread in the team.
+ */
+
+static void count_slice(ThreadTeam *team, int id) {
+
+  int begin = 0, end = 0;
+
+  if (id < team->n_slices) {
+    begin = (long)team->n_bytes * id / team->n_slices;
+    end = (long)team->n_bytes * (id + 1) / team->n_slices;
+  }
+
+  processChunk(team->bytes + begin, end - begin, &team->results[id]);
+}
+
+/**
+ *  \brief Life cycle of the threads of the team, other than the main thread.
+ *
+ *  \param arg member of the team.
+ */
+
+static void *team_member(void *arg) {
+
+  TeamMember *member = (TeamMember *)arg;
+  ThreadTeam *team = member->team;
+  int seen = 0;
+
+  while (true) {
+
+    /* wait for the next chunk */
+    pthread_mutex_lock(&team->lock);
+    while (team->generation == seen)
+      pthread_cond_wait(&team->work_ready, &team->lock);
+    seen = team->generation;
+    pthread_mutex_unlock(&team->lock);
+
+    if (team->stop)
+      break;
+
+    count_slice(team, member->id);
+
+    /* the last thread to finish wakes up the main thread */
+    pthread_mutex_lock(&team->lock);
+    if (--team->pending == 0)
+      pthread_cond_signal(&team->work_done);
+    pthread_mutex_unlock(&team->lock);
+  }
+
+  return NULL;
+}
+
+/**
+ *  \brief Process a chunk with the team, the main thread taking the first slice.
+ *
+ *  Small chunks are not split below NUM_BYTES per thread.
+ *
+ *  \param team team of threads.
+ *  \param bytes chunk of UTF-8 encoded text.
+ *  \param n_bytes number of bytes in the chunk.
+ *  \param result merged partial results of the chunk.
+ */
+
+static void team_process(ThreadTeam *team, const unsigned char *bytes, int n_bytes, ChunkResult *result) {
+
+  pthread_mutex_lock(&team->lock);
+  team->bytes = bytes;
+  team->n_bytes = n_bytes;
+  team->n_slices = n_bytes / NUM_BYTES < team->n_threads ? n_bytes / NUM_BYTES : team->n_threads;
+  if (team->n_slices < 1)
+    team->n_slices = 1;
+  team->pending = team->n_threads - 1;
+  team->generation++;
+  pthread_cond_broadcast(&team->work_ready);
+  pthread_mutex_unlock(&team->lock);
+
+  count_slice(team, 0);
+
+  pthread_mutex_lock(&team->lock);
+  while (team->pending > 0)
+    pthread_cond_wait(&team->work_done, &team->lock);
+  pthread_mutex_unlock(&team->lock);
+
+  /* merge the slices in order */
+  *result = team->results[0];
+  for (int i = 1; i < team->n_slices; i++)
+    result_merge(result, &team->results[i], result);
+}
+
+/**
+ *  \brief hybrid worker.
+ *
+ *  Starts a team of threads and keeps MAX_IN_FLIGHT chunks posted, so the next chunk can arrive
+ *  while the current one is processed by the team.
+ *
+ *  \param rank worker id.
+ *  \param n_threads number of threads of the team, 0 for one per online core.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void hybrid_worker(int rank, int n_threads, int chunk_bytes) {
+
+  ThreadTeam team;
+  TeamMember *members;
+  ChunkHeader headers[MAX_IN_FLIGHT];
+  unsigned char *buffers[MAX_IN_FLIGHT];
+  MPI_Request requests[2 * MAX_IN_FLIGHT];
+  ChunkResult result;
+  int slot = 0;
+
+  if (n_threads <= 0)
+    n_threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+  /* start the team, the main thread being its first member */
+  team.n_threads = n_threads;
+  team.threads = malloc(n_threads * sizeof(pthread_t));
+  team.results = malloc(n_threads * sizeof(ChunkResult));
+  team.generation = 0;
+  team.pending = 0;
+  team.stop = false;
+  pthread_mutex_init(&team.lock, NULL);
+  pthread_cond_init(&team.work_ready, NULL);
+  pthread_cond_init(&team.work_done, NULL);
+
+  members = malloc(n_threads * sizeof(TeamMember));
+  for (int i = 1; i < n_threads; i++) {
+    members[i].team = &team;
+    members[i].id = i;
+    if (pthread_create(&team.threads[i], NULL, team_member, &members[i]) != 0) {
+      fprintf(stderr, "Worker %d: could not start thread %d\n", rank, i);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* post the receives of every buffer */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+    buffers[i] = malloc(chunk_bytes);
+    MPI_Irecv(&headers[i], sizeof(ChunkHeader), MPI_BYTE, 0, TAG_HEADER, MPI_COMM_WORLD, &requests[2 * i]);
+    MPI_Irecv(buffers[i], chunk_bytes, MPI_BYTE, 0, TAG_BYTES, MPI_COMM_WORLD, &requests[2 * i + 1]);
+  }
+
+  /* chunks arrive in order, one buffer after the other */
+  while (true) {
+
+    MPI_Wait(&requests[2 * slot], MPI_STATUS_IGNORE);
+
+    /* if no more work */
+    if (headers[slot].n_bytes < 0)
+      break;
+
+    MPI_Wait(&requests[2 * slot + 1], MPI_STATUS_IGNORE);
+
+    team_process(&team, buffers[slot], headers[slot].n_bytes, &result);
+
+    result.file_index = headers[slot].file_index;
+    result.chunk_index = headers[slot].chunk_index;
+
+    /* the buffer is free again before the dispatcher gets the result */
+    MPI_Irecv(&headers[slot], sizeof(ChunkHeader), MPI_BYTE, 0, TAG_HEADER, MPI_COMM_WORLD, &requests[2 * slot]);
+    MPI_Irecv(buffers[slot], chunk_bytes, MPI_BYTE, 0, TAG_BYTES, MPI_COMM_WORLD, &requests[2 * slot + 1]);
+
+    MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+
+    slot = (slot + 1) % MAX_IN_FLIGHT;
+  }
+
+  /* the other buffers also receive the end signal, and no more bytes */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+    if (i != slot)
+      MPI_Wait(&requests[2 * i], MPI_STATUS_IGNORE);
+    MPI_Cancel(&requests[2 * i + 1]);
+    MPI_Wait(&requests[2 * i + 1], MPI_STATUS_IGNORE);
+    free(buffers[i]);
+  }
+
+  /* stop the team */
+  pthread_mutex_lock(&team.lock);
+  team.stop = true;
+  team.generation++;
+  pthread_cond_broadcast(&team.work_ready);
+  pthread_mutex_unlock(&team.lock);
+
+  for (int i = 1; i < n_threads; i++)
+    pthread_join(team.threads[i], NULL);
+
+  pthread_mutex_destroy(&team.lock);
+  pthread_cond_destroy(&team.work_ready);
+  pthread_cond_destroy(&team.work_done);
+  free(team.threads);
+  free(team.results);
+  free(members);
+}
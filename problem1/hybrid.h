@@ -0,0 +1,23 @@
+/**
+ *  \file hybrid.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the hybrid mode, where every worker rank splits large chunks
+ *  across a team of threads:
+ *     \li hybrid_dispatcher
+ *     \li hybrid_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef HYBRID_H_
+#define HYBRID_H_
+
+/** \brief Send large chunks to the workers on demand and gather their results */
+extern void hybrid_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Receive large chunks and process them with a team of threads */
+extern void hybrid_worker(int rank, int n_threads, int chunk_bytes);
+
+#endif /* HYBRID_H_ */
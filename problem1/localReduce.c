@@ -0,0 +1,362 @@
+/**
+ *  \file localReduce.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Local accumulation mode. The chunks are assigned round-robin, in runs of MAX_IN_FLIGHT
+ *  consecutive chunks, so the dispatcher needs no reply to know who gets the next one, and the
+ *  workers send nothing back while they count. Each worker merges the chunks of a run, adds their
+ *  counters to per-file counters and only keeps the small state at the boundaries of the run. At
+ *  the end the counters are summed with a single MPI_Reduce and the boundary states are gathered
+ *  once, to settle the words cut between runs.
+ *
+ *  Definition of the operations:
+ *     \li round_robin_send
+ *     \li round_robin_receive
+ *     \li local_dispatcher
+ *     \li local_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "partialResult.h"
+#include "localReduce.h"
+
+/**
+ *  \brief Order the boundary states by file and chunk.
+ */
+
+static int compare_acks(const void *a, const void *b) {
+
+  const ChunkAck *left = (const ChunkAck *)a;
+  const ChunkAck *right = (const ChunkAck *)b;
+
+  if (left->file_index != right->file_index)
+    return left->file_index < right->file_index ? -1 : 1;
+
+  return (left->chunk_index > right->chunk_index) - (left->chunk_index < right->chunk_index);
+}
+
+/**
+ *  \brief Hand out all the chunks round-robin, without waiting for any reply.
+ *
+ *  Chunk i goes to worker (i / run) % n_workers + 1, so each worker gets runs of consecutive
+ *  chunks. Each worker has a ring of MAX_IN_FLIGHT buffers, sent with synchronous sends, so a
+ *  buffer is only reused once the worker took the chunk out of it and the reading never gets too
+ *  far ahead of a worker. The end of the work is signalled with a header whose size is -1 on every
+ *  buffer of each worker.
+ *
+ *  Operation carried out by the dispatcher, after allocateMemory.
+ *
+ *  \param chunk_bytes size of the chunks.
+ *  \param run number of consecutive chunks given to a worker before the next one.
+ */
+
+void round_robin_send(int chunk_bytes, int run) {
+
+  int n_workers, n_slots;
+  int worker_id = 1;
+  int in_run = 0;
+  ChunkHeader end;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &n_workers);
+  n_workers -= 1;
+  n_slots = n_workers * MAX_IN_FLIGHT;
+
+  /* send buffers and requests of every worker */
+  WireChunk **slots = malloc(n_slots * sizeof(WireChunk *));
+  MPI_Request *requests = malloc(n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_workers, sizeof(int));
+
+  for (int i = 0; i < n_slots; i++) {
+    slots[i] = malloc(WIRE_BYTES(chunk_bytes));
+    requests[i] = MPI_REQUEST_NULL;
+  }
+
+  while (true) {
+
+    /* move on to the next worker once the run is complete */
+    if (in_run == run) {
+      worker_id = worker_id % n_workers + 1;
+      in_run = 0;
+    }
+
+    int slot = (worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1];
+
+    /* make sure the worker took the previous chunk out of this buffer */
+    MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+
+    if (!getChunk(slots[slot], chunk_bytes))
+      break;
+
+    MPI_Issend(slots[slot], WIRE_SIZE(slots[slot]), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &requests[slot]);
+
+    next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+    in_run++;
+  }
+
+  MPI_Waitall(n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal workers that there is no more work to be done, on every buffer */
+  end.n_bytes = -1;
+  for (int slot = 0; slot < n_slots; slot++)
+    MPI_Send(&end, sizeof(ChunkHeader), MPI_BYTE, slot / MAX_IN_FLIGHT + 1, 0, MPI_COMM_WORLD);
+
+  for (int i = 0; i < n_slots; i++)
+    free(slots[i]);
+
+  free(slots);
+  free(requests);
+  free(next_slot);
+}
+
+/**
+ *  \brief Receive the chunks handed out round-robin and process each one.
+ *
+ *  Keeps MAX_IN_FLIGHT receives posted, so the next chunks arrive while the current one is
+ *  processed, until the end signal.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param chunk_bytes size of the chunks.
+ *  \param process function called with each chunk.
+ *  \param arg argument passed on to the function.
+ */
+
+void round_robin_receive(int chunk_bytes, void (*process)(const WireChunk *chunk, void *arg), void *arg) {
+
+  int slot = 0;
+  WireChunk *chunks[MAX_IN_FLIGHT];
+  MPI_Request requests[MAX_IN_FLIGHT];
+
+  for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+    chunks[i] = malloc(WIRE_BYTES(chunk_bytes));
+    MPI_Irecv(chunks[i], WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &requests[i]);
+  }
+
+  /* chunks arrive in order, one buffer after the other */
+  while (true) {
+
+    MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+
+    /* if no more work */
+    if (chunks[slot]->header.n_bytes < 0)
+      break;
+
+    process(chunks[slot], arg);
+
+    MPI_Irecv(chunks[slot], WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &requests[slot]);
+
+    slot = (slot + 1) % MAX_IN_FLIGHT;
+  }
+
+  /* the other buffers also receive the end signal */
+  for (int i = 1; i < MAX_IN_FLIGHT; i++)
+    MPI_Wait(&requests[(slot + i) % MAX_IN_FLIGHT], MPI_STATUS_IGNORE);
+
+  for (int i = 0; i < MAX_IN_FLIGHT; i++)
+    free(chunks[i]);
+}
+
+/**
+ *  \brief local accumulation dispatcher.
+ *
+ *  Hands out the chunks round-robin and, once they are all counted, combines the counters and the
+ *  boundary states of the workers.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void local_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int size;
+  int files = num_files;
+  int n_acks = 0;
+  ChunkResult result;
+  MPI_Datatype ack_type;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  /* the workers need the number of files for their counters */
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  /* one chunk of each run per buffer of the worker */
+  round_robin_send(chunk_bytes, MAX_IN_FLIGHT);
+
+  /* sum the counters of the workers, the root adding none */
+  long long *counters = calloc(3 * files, sizeof(long long));
+  MPI_Reduce(MPI_IN_PLACE, counters, 3 * files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  /* gather the boundary states of all the runs, counted in acks */
+  int *counts = malloc(size * sizeof(int));
+  int *displs = malloc(size * sizeof(int));
+
+  MPI_Gather(&n_acks, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  for (int i = 0; i < size; i++) {
+    displs[i] = n_acks;
+    n_acks += counts[i];
+  }
+
+  MPI_Type_contiguous(sizeof(ChunkAck), MPI_BYTE, &ack_type);
+  MPI_Type_commit(&ack_type);
+
+  ChunkAck *acks = malloc((n_acks > 0 ? n_acks : 1) * sizeof(ChunkAck));
+  MPI_Gatherv(NULL, 0, ack_type, acks, counts, displs, ack_type, 0, MPI_COMM_WORLD);
+
+  MPI_Type_free(&ack_type);
+
+  /* the counters come first, as a file may be printed once its last boundary is merged */
+  for (int i = 0; i < files; i++)
+    add_file_counters(i, counters[3 * i], counters[3 * i + 1], counters[3 * i + 2]);
+
+  /* settle the words cut between runs, in chunk order */
+  qsort(acks, n_acks, sizeof(ChunkAck), compare_acks);
+
+  for (int i = 0; i < n_acks; i++) {
+    result_from_ack(&acks[i], &result);
+    save_file_results(&result);
+
+    /* the other chunks of the run are already merged into it, they follow as empty pieces */
+    for (int j = 1; j < acks[i].n_chunks; j++) {
+      result_init(&result, acks[i].file_index);
+      result.chunk_index = acks[i].chunk_index + j;
+      save_file_results(&result);
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  free(counters);
+  free(counts);
+  free(displs);
+  free(acks);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/** \brief counters and boundary states kept by a worker in the local accumulation mode */
+typedef struct {
+  long long *counters;
+  ChunkAck *acks;
+  int n_acks;
+  int max_acks;
+  ChunkResult run;          /* merged result of the run in progress */
+  int run_chunks;           /* number of chunks of the run, 0 if none */
+} LocalCounts;
+
+/**
+ *  \brief Add the run in progress to the per-file counters and keep the state at its boundaries.
+ *
+ *  \param local counters of the worker.
+ */
+
+static void end_run(LocalCounts *local) {
+
+  ChunkResult *run = &local->run;
+
+  if (local->run_chunks == 0)
+    return;
+
+  /* the counters stay here, only the boundaries are kept for the end */
+  local->counters[3 * run->file_index] += run->num_words;
+  local->counters[3 * run->file_index + 1] += run->num_vowels;
+  local->counters[3 * run->file_index + 2] += run->num_cons;
+
+  if (local->n_acks == local->max_acks) {
+    local->max_acks = local->max_acks ? 2 * local->max_acks : 1024;
+    local->acks = realloc(local->acks, local->max_acks * sizeof(ChunkAck));
+  }
+  result_to_ack(run, &local->acks[local->n_acks]);
+  local->acks[local->n_acks++].n_chunks = local->run_chunks;
+
+  local->run_chunks = 0;
+}
+
+/**
+ *  \brief Count a chunk and merge it into the run in progress, if it is the next chunk of its file.
+ *
+ *  \param chunk chunk received.
+ *  \param arg counters of the worker.
+ */
+
+static void count_chunk(const WireChunk *chunk, void *arg) {
+
+  LocalCounts *local = (LocalCounts *)arg;
+  ChunkResult result;
+
+  processChunk(chunk->bytes, chunk->header.n_bytes, &result);
+
+  result.file_index = chunk->header.file_index;
+  result.chunk_index = chunk->header.chunk_index;
+
+  if (local->run_chunks > 0 && result.file_index == local->run.file_index &&
+      result.chunk_index == local->run.chunk_index + local->run_chunks) {
+    result_merge(&local->run, &result, &local->run);
+    local->run_chunks++;
+    return;
+  }
+
+  end_run(local);
+
+  local->run = result;
+  local->run_chunks = 1;
+}
+
+/**
+ *  \brief local accumulation worker.
+ *
+ *  Counts each run of chunks into per-file counters, keeping only the state at its boundaries
+ *  until the final reduction.
+ *
+ *  \param rank worker id.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void local_worker(int rank, int chunk_bytes) {
+
+  int files;
+  LocalCounts local = { .counters = NULL, .acks = NULL, .n_acks = 0, .max_acks = 0, .run_chunks = 0 };
+  MPI_Datatype ack_type;
+
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  local.counters = calloc(3 * files, sizeof(long long));
+
+  round_robin_receive(chunk_bytes, count_chunk, &local);
+  end_run(&local);
+
+  MPI_Reduce(local.counters, NULL, 3 * files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  MPI_Gather(&local.n_acks, 1, MPI_INT, NULL, 0, MPI_INT, 0, MPI_COMM_WORLD);
+
+  MPI_Type_contiguous(sizeof(ChunkAck), MPI_BYTE, &ack_type);
+  MPI_Type_commit(&ack_type);
+  MPI_Gatherv(local.acks, local.n_acks, ack_type, NULL, NULL, NULL, ack_type, 0, MPI_COMM_WORLD);
+  MPI_Type_free(&ack_type);
+
+  free(local.counters);
+  free(local.acks);
+}
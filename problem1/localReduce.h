@@ -0,0 +1,33 @@
+/**
+ *  \file localReduce.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the local accumulation mode, where the workers keep their
+ *  counters and combine them once at the end:
+ *     \li round_robin_send
+ *     \li round_robin_receive
+ *     \li local_dispatcher
+ *     \li local_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef LOCALREDUCE_H_
+#define LOCALREDUCE_H_
+
+#include "MessageStruct.h"
+
+/** \brief Hand out all the chunks round-robin, without waiting for any reply */
+extern void round_robin_send(int chunk_bytes, int run);
+
+/** \brief Receive the chunks handed out round-robin and process each one */
+extern void round_robin_receive(int chunk_bytes, void (*process)(const WireChunk *chunk, void *arg), void *arg);
+
+/** \brief Send the chunks round-robin and combine the counters of the workers at the end */
+extern void local_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Count the chunks received into per-file counters kept until the end */
+extern void local_worker(int rank, int chunk_bytes);
+
+#endif /* LOCALREDUCE_H_ */
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
@@ -23,6 +24,16 @@
 #include "dispatcher.h"
 #include "worker.h"
 #include "probConst.h"
+#include "mpiio.h"
+#include "hybrid.h"
+#include "localReduce.h"
+#include "freq.h"
+#include "blocks.h"
+#include "shm.h"
+#include "planner.h"
+#include "tree.h"
+#include "scatter.h"
+#include "standalone.h"
 
 /** \brief time limits */
 struct timespec start, finish;
@@ -30,6 +41,42 @@ struct timespec start, finish;
 /** \brief number of workers */
 int n_workers;
 
+/** \brief scheduling mode used by the dispatcher */
+int mode = MODE_LOCKSTEP;
+
+/** \brief number of threads of each worker in the hybrid mode, 0 for one per online core */
+int n_threads = 0;
+
+/** \brief size of the chunks sent to the workers, the smallest one in the adaptive mode */
+int chunk_bytes = 0;
+
+/** \brief seconds between the rolling totals of the streaming mode, 0 for none */
+double report_interval = 0;
+
+/** \brief bytes between the rolling totals of the streaming mode, 0 for none */
+long long report_bytes = 0;
+
+/** \brief name of the progress journal, NULL if none is kept */
+char *journal = NULL;
+
+/** \brief seconds between two writes of the progress journal */
+double checkpoint_interval = JOURNAL_INTERVAL;
+
+/** \brief name of the result cache, NULL if none is kept */
+char *cache = NULL;
+
+/** \brief 1 to resume from the progress journal */
+int resume = 0;
+
+/** \brief number of most frequent words printed for every file in the word frequency mode */
+int top_k = FREQ_TOP_K;
+
+/** \brief when the results of each file are printed */
+int output_when = EMIT_END;
+
+/** \brief 1 to print the results as JSON lines */
+int output_json = 0;
+
 /**
  *  \brief dispatcher.
  *
@@ -46,7 +93,10 @@ void dispatcher(char *file_names[], unsigned int num_files) {
   int last_worker;
 
   /* structure to save file chunks */
-  MessageStruct messageStruct;
+  WireChunk *chunk = malloc(WIRE_BYTES(chunk_bytes));
+
+  /* structure to receive partial results */
+  ChunkResult result;
 
   /* bool to indicate workers if is still work to be done */
   bool still_work = true;
@@ -57,7 +107,7 @@ void dispatcher(char *file_names[], unsigned int num_files) {
   clock_gettime (CLOCK_MONOTONIC_RAW, &start); 
 
   /* while there is data available to read */
-  while(getVal((MessageStruct *) &messageStruct)) {
+  while(getChunk(chunk, chunk_bytes)) {
 
     /* signal workers that there is work to be done and send them the chunks */
     for(worker_id = 1; worker_id <= n_workers; worker_id++){
@@ -68,21 +118,21 @@ void dispatcher(char *file_names[], unsigned int num_files) {
       /* signal that there is work to be done */
       MPI_Send(&still_work, 1, MPI_C_BOOL, worker_id, 0, MPI_COMM_WORLD);
 
-      /* send the chunks */
-      MPI_Send(&messageStruct, sizeof(MessageStruct), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+      /* send the chunks, sized to the bytes read */
+      MPI_Send(chunk, WIRE_SIZE(chunk), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
 
 
-      if(worker_id < n_workers && !getVal((MessageStruct *) &messageStruct))
+      if(worker_id < n_workers && !getChunk(chunk, chunk_bytes))
         break;
     }
 
     /* receive messages from workers and save partial results */
     for(worker_id = 1; worker_id <= last_worker; worker_id++){
 
-      MPI_Recv(&messageStruct, sizeof(MessageStruct), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
       /* save results of the chunk */
-      save_file_results((MessageStruct *) &messageStruct);
+      save_file_results(&result);
 
     }
 
@@ -97,11 +147,357 @@ void dispatcher(char *file_names[], unsigned int num_files) {
     MPI_Send(&still_work, 1, MPI_C_BOOL, i, 0, MPI_COMM_WORLD);
   }
 
-  /* print final reults */
+  free(chunk);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+
+}
+
+
+/**
+ *  \brief Read the next chunk and post it to a worker, without waiting for the transfer.
+ *
+ *  Each worker owns a ring of MAX_IN_FLIGHT send buffers. Workers return results in the order
+ *  they received the chunks, so when a result arrives the oldest buffer of that worker is free.
+ *  A buffer is grown when the chunk size of its worker goes beyond its capacity.
+ *
+ *  \param worker_id worker to send the chunk to.
+ *  \param slots send buffers of all workers.
+ *  \param capacity number of bytes that fit in each buffer.
+ *  \param requests pending send requests, two for each buffer.
+ *  \param next_slot next buffer to be used by each worker.
+ *  \param max_bytes size of the chunk.
+ *  \return true if a chunk was sent, false if there is no more data to read.
+ */
+
+static bool post_chunk(int worker_id, WireChunk **slots, int *capacity, MPI_Request *requests, int *next_slot,
+                       int max_bytes) {
+
+  /* signal that there is work to be done, never modified while sends are pending */
+  static bool still_work = true;
+
+  int slot = (worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1];
+
+  /* make sure the previous transfer from this buffer is over */
+  MPI_Waitall(2, &requests[2 * slot], MPI_STATUSES_IGNORE);
+
+  if(capacity[slot] < max_bytes){
+    free(slots[slot]);
+    slots[slot] = malloc(WIRE_BYTES(max_bytes));
+    capacity[slot] = max_bytes;
+  }
+
+  if(!getChunk(slots[slot], max_bytes))
+    return false;
+
+  MPI_Isend(&still_work, 1, MPI_C_BOOL, worker_id, 0, MPI_COMM_WORLD, &requests[2 * slot]);
+  MPI_Isend(slots[slot], WIRE_SIZE(slots[slot]), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &requests[2 * slot + 1]);
+
+  next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+
+  return true;
+}
+
+/**
+ *  \brief Grow or shrink the chunk size of a worker from the timings of its last chunk.
+ *
+ *  The size is doubled while the time spent outside the computation, in the transfers and in the
+ *  dispatcher, is more than ADAPT_OVERHEAD of the computation, and halved when a chunk keeps the
+ *  worker busy for more than ADAPT_MAX_TIME, so the work stays balanced.
+ *
+ *  \param size chunk size of the worker, between chunk_bytes and ADAPT_MAX_BYTES.
+ *  \param round_trip seconds from the moment the worker could start the chunk to its result.
+ *  \param compute_time seconds the worker spent on the chunk.
+ */
+
+static void adapt_chunk_size(int *size, double round_trip, double compute_time) {
+
+  if(round_trip - compute_time > ADAPT_OVERHEAD * compute_time)
+    *size *= 2;
+  else if(compute_time > ADAPT_MAX_TIME)
+    *size /= 2;
+
+  if(*size > ADAPT_MAX_BYTES)
+    *size = ADAPT_MAX_BYTES;
+  if(*size < chunk_bytes)
+    *size = chunk_bytes;
+}
+
+/**
+ *  \brief Size of the next chunk of a worker in the adaptive mode.
+ *
+ *  Near the end of the input the chunks are cut to a share of the bytes left, so that the last
+ *  chunks are spread over all the workers.
+ *
+ *  \param size chunk size of the worker.
+ *  \return size of the next chunk.
+ */
+
+static int tail_chunk_size(int size) {
+
+  long long left = input_bytes_left();
+
+  if(left >= 0 && left / (ADAPT_TAIL_SHARE * n_workers) < size)
+    size = left / (ADAPT_TAIL_SHARE * n_workers);
+
+  return size < chunk_bytes ? chunk_bytes : size;
+}
+
+/**
+ *  \brief dynamic dispatcher.
+ *
+ *  Demand-driven version of the dispatcher. Every worker is kept with up to MAX_IN_FLIGHT chunks
+ *  queued and, as soon as any of them returns a result, it is handed its next chunk, so a slow
+ *  worker never stalls the others.
+ *
+ *  In the adaptive mode each worker has its own chunk size. It starts at chunk_bytes, follows the
+ *  round trip and compute time of the worker's chunks, and shrinks again near the end of the input.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ */
+
+void dynamic_dispatcher(char *file_names[], unsigned int num_files) {
+
+  int worker_id;
+  int n_slots = n_workers * MAX_IN_FLIGHT;
+  int in_flight = 0;
+  bool data_left = true;
+  bool adaptive = mode == MODE_ADAPTIVE;
+  MPI_Status status;
+
+  /* structure to receive partial results */
+  ChunkResult result;
+
+  /* send buffers and requests of every worker */
+  WireChunk **slots = calloc(n_slots, sizeof(WireChunk *));
+  int *capacity = calloc(n_slots, sizeof(int));
+  MPI_Request *requests = malloc(2 * n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_workers, sizeof(int));
+
+  /* chunk size of every worker, when each chunk was posted and since when each worker is free */
+  int *sizes = malloc(n_workers * sizeof(int));
+  double *post_time = malloc(n_slots * sizeof(double));
+  double *free_since = malloc(n_workers * sizeof(double));
+  int *done_slot = calloc(n_workers, sizeof(int));
+
+  for(int i = 0; i < 2 * n_slots; i++)
+    requests[i] = MPI_REQUEST_NULL;
+
+  for(int i = 0; i < n_workers; i++)
+    sizes[i] = chunk_bytes;
+
+  /* bool to indicate workers that there is no more work to be done */
+  bool still_work = false;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  for(int i = 0; i < n_workers; i++)
+    free_since[i] = MPI_Wtime();
+
+  /* fill the queue of every worker */
+  for(int depth = 0; depth < MAX_IN_FLIGHT && data_left; depth++){
+    for(worker_id = 1; worker_id <= n_workers && data_left; worker_id++){
+      post_time[(worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1]] = MPI_Wtime();
+      data_left = post_chunk(worker_id, slots, capacity, requests, next_slot,
+                             adaptive ? tail_chunk_size(sizes[worker_id - 1]) : chunk_bytes);
+      if(data_left)
+        in_flight++;
+    }
+  }
+
+  /* collect results from whichever worker finishes first and give it more work */
+  while(in_flight > 0){
+
+    MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    in_flight--;
+
+    worker_id = status.MPI_SOURCE;
+
+    /* the chunk could only start once the worker was done with the previous one */
+    if(adaptive){
+      int w = worker_id - 1;
+      int slot = w * MAX_IN_FLIGHT + done_slot[w];
+      double now = MPI_Wtime();
+      double begin = post_time[slot] > free_since[w] ? post_time[slot] : free_since[w];
+
+      adapt_chunk_size(&sizes[w], now - begin, result.compute_time);
+      free_since[w] = now;
+      done_slot[w] = (done_slot[w] + 1) % MAX_IN_FLIGHT;
+    }
+
+    /* save results of the chunk */
+    save_file_results(&result);
+
+    if(data_left){
+      post_time[(worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1]] = MPI_Wtime();
+      data_left = post_chunk(worker_id, slots, capacity, requests, next_slot,
+                             adaptive ? tail_chunk_size(sizes[worker_id - 1]) : chunk_bytes);
+      if(data_left)
+        in_flight++;
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  MPI_Waitall(2 * n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal workers that there is no more work to be done */
+  for(int i = 1; i <= n_workers; i++){
+    MPI_Send(&still_work, 1, MPI_C_BOOL, i, 0, MPI_COMM_WORLD);
+  }
+
+  for(int i = 0; i < n_slots; i++)
+    free(slots[i]);
+
+  free(slots);
+  free(capacity);
+  free(requests);
+  free(next_slot);
+  free(sizes);
+  free(post_time);
+  free(free_since);
+  free(done_slot);
+
+  /* print final results */
   print_final_results();
+  print_elapsed(start, finish);
+
+}
+
+
+/**
+ *  \brief streaming dispatcher.
+ *
+ *  Meant for unbounded input from the standard input ("-") or a FIFO. Chunks are read as soon as
+ *  the data arrives and a worker has room for them, while the results are collected in between,
+ *  so that the totals counted so far can be printed every report_interval seconds or every
+ *  report_bytes bytes. The memory used does not depend on the size of the input: one read buffer,
+ *  MAX_IN_FLIGHT chunks per worker and one merged result per file.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ */
+
+void stream_dispatcher(char *file_names[], unsigned int num_files) {
+
+  int worker_id = 0, free_worker;
+  int n_slots = n_workers * MAX_IN_FLIGHT;
+  int in_flight = 0;
+  int flag;
+  bool data_left = true;
+  long long bytes_read = 0;
+  long long next_report = report_bytes;
+  double next_time;
+  MPI_Status status;
+  MPI_Request result_request;
+
+  /* structure to receive partial results */
+  ChunkResult result;
+
+  /* send buffers and requests of every worker, and number of chunks queued in each one */
+  WireChunk **slots = calloc(n_slots, sizeof(WireChunk *));
+  int *capacity = calloc(n_slots, sizeof(int));
+  MPI_Request *requests = malloc(2 * n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_workers, sizeof(int));
+  int *queued = calloc(n_workers, sizeof(int));
+
+  for(int i = 0; i < 2 * n_slots; i++)
+    requests[i] = MPI_REQUEST_NULL;
+
+  /* bool to indicate workers that there is no more work to be done */
+  bool still_work = false;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
 
-  /* print enlapsed time */
-  printf ("\nElapsed time = %.6f s\n",  (finish.tv_sec - start.tv_sec) / 1.0 + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+  next_time = MPI_Wtime() + report_interval;
+
+  MPI_Irecv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &result_request);
+
+  while(data_left || in_flight > 0){
+
+    /* look for a worker with room for another chunk */
+    free_worker = 0;
+    for(int i = 0; i < n_workers && data_left; i++){
+      worker_id = worker_id % n_workers + 1;
+      if(queued[worker_id - 1] < MAX_IN_FLIGHT){
+        free_worker = worker_id;
+        break;
+      }
+    }
+
+    /* all workers are busy, so wait for a result */
+    if(!free_worker){
+      MPI_Wait(&result_request, &status);
+      flag = 1;
+    }
+
+    /* send the input that already arrived, without blocking the collection of the results */
+    else{
+      if(wait_for_input(STREAM_POLL_MS)){
+        int slot = (free_worker - 1) * MAX_IN_FLIGHT + next_slot[free_worker - 1];
+        data_left = post_chunk(free_worker, slots, capacity, requests, next_slot, chunk_bytes);
+        if(data_left){
+          in_flight++;
+          queued[free_worker - 1]++;
+          bytes_read += slots[slot]->header.n_bytes;
+        }
+      }
+      MPI_Test(&result_request, &flag, &status);
+    }
+
+    /* save the results that arrived */
+    while(flag){
+      in_flight--;
+      queued[status.MPI_SOURCE - 1]--;
+      save_file_results(&result);
+
+      MPI_Irecv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &result_request);
+      MPI_Test(&result_request, &flag, &status);
+    }
+
+    /* print the rolling totals */
+    if((report_bytes > 0 && bytes_read >= next_report) || (report_interval > 0 && MPI_Wtime() >= next_time)){
+      print_rolling_results(bytes_read);
+
+      while(report_bytes > 0 && next_report <= bytes_read)
+        next_report += report_bytes;
+      next_time = MPI_Wtime() + report_interval;
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  MPI_Cancel(&result_request);
+  MPI_Wait(&result_request, MPI_STATUS_IGNORE);
+
+  MPI_Waitall(2 * n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal workers that there is no more work to be done */
+  for(int i = 1; i <= n_workers; i++){
+    MPI_Send(&still_work, 1, MPI_C_BOOL, i, 0, MPI_COMM_WORLD);
+  }
+
+  for(int i = 0; i < n_slots; i++)
+    free(slots[i]);
+
+  free(slots);
+  free(capacity);
+  free(requests);
+  free(next_slot);
+  free(queued);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
 
 }
 
@@ -118,9 +514,16 @@ void dispatcher(char *file_names[], unsigned int num_files) {
 void worker(int rank){
 
   bool still_work;
+  int n_bytes;
+  int capacity = chunk_bytes;
+  MPI_Status status;
+  struct timespec begin, end;
+
+  /* structure that contains chunk information, grown to the largest chunk received */
+  WireChunk *chunk = malloc(WIRE_BYTES(capacity));
 
-  /* structure that contains chunk information */
-  MessageStruct messageStruct;
+  /* structure with the partial results */
+  ChunkResult result;
 
   while (true) {
 
@@ -129,36 +532,248 @@ void worker(int rank){
 
     /* if no work, return */
     if(!still_work){
-      return;
+      break;
     }
 
     /* else, work */
     else{
-      /* receive the chunk */
-      MPI_Recv(&messageStruct, sizeof(MessageStruct), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      /* receive the chunk, whose size may change from one chunk to the next */
+      MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+      MPI_Get_count(&status, MPI_BYTE, &n_bytes);
+
+      if(n_bytes > (int)WIRE_BYTES(capacity)){
+        capacity = n_bytes - sizeof(ChunkHeader);
+        free(chunk);
+        chunk = malloc(WIRE_BYTES(capacity));
+      }
+
+      MPI_Recv(chunk, n_bytes, MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
-      /* process chunk */
-      processVal((MessageStruct *) &messageStruct);
+      clock_gettime (CLOCK_MONOTONIC, &begin);
+
+      /* decode and process chunk */
+      processChunk(chunk->bytes, chunk->header.n_bytes, &result);
+
+      clock_gettime (CLOCK_MONOTONIC, &end);
+
+      result.file_index = chunk->header.file_index;
+      result.chunk_index = chunk->header.chunk_index;
+      result.compute_time = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1000000000.0;
 
       /* send results */
-      MPI_Send(&messageStruct, sizeof(MessageStruct), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+      MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
     }
 
   }
-  
 
+  free(chunk);
+}
+
+/**
+ *  \brief pipelined dispatcher.
+ *
+ *  Every worker has a ring of PIPELINE_DEPTH chunk and result buffers, the results arriving through
+ *  persistent receives. When a result arrives, the freed buffer is refilled and sent right away, so
+ *  reading the next chunks overlaps with the computation of the workers and with the transfers.
+ *  The chunks are sent with MPI_Isend, sized to their payload as in the other modes, as the last
+ *  chunk of a file is shorter. The end of the work is signalled with chunk headers whose size is
+ *  -1 instead of a separate message per chunk.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ */
+
+void pipeline_dispatcher(char *file_names[], unsigned int num_files) {
+
+  int n_slots = n_workers * PIPELINE_DEPTH;
+  int in_flight = 0;
+  int slot;
+  bool data_left = true;
+
+  /* buffers and persistent requests of every slot, worker w owning slots (w - 1) * PIPELINE_DEPTH onwards */
+  WireChunk **chunks = malloc(n_slots * sizeof(WireChunk *));
+  ChunkResult *results = malloc(n_slots * sizeof(ChunkResult));
+  MPI_Request *send_requests = malloc(n_slots * sizeof(MPI_Request));
+  MPI_Request *recv_requests = malloc(n_slots * sizeof(MPI_Request));
+
+  for(slot = 0; slot < n_slots; slot++){
+    int worker_id = slot / PIPELINE_DEPTH + 1;
+    chunks[slot] = malloc(WIRE_BYTES(chunk_bytes));
+    send_requests[slot] = MPI_REQUEST_NULL;
+    MPI_Recv_init(&results[slot], sizeof(ChunkResult), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &recv_requests[slot]);
+  }
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  /* fill the ring of every worker, one slot of each worker at a time */
+  for(int depth = 0; depth < PIPELINE_DEPTH && data_left; depth++){
+    for(int worker_id = 1; worker_id <= n_workers && data_left; worker_id++){
+      slot = (worker_id - 1) * PIPELINE_DEPTH + depth;
+      data_left = getChunk(chunks[slot], chunk_bytes);
+      if(data_left){
+        MPI_Start(&recv_requests[slot]);
+        MPI_Isend(chunks[slot], WIRE_SIZE(chunks[slot]), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &send_requests[slot]);
+        in_flight++;
+      }
+    }
+  }
+
+  /* refill each slot as soon as its result arrives */
+  while(in_flight > 0){
+
+    MPI_Waitany(n_slots, recv_requests, &slot, MPI_STATUS_IGNORE);
+    in_flight--;
+
+    /* save results of the chunk */
+    save_file_results(&results[slot]);
+
+    /* the worker already received the chunk, so its buffer is free */
+    MPI_Wait(&send_requests[slot], MPI_STATUS_IGNORE);
+
+    if(data_left && (data_left = getChunk(chunks[slot], chunk_bytes))){
+      MPI_Start(&recv_requests[slot]);
+      MPI_Isend(chunks[slot], WIRE_SIZE(chunks[slot]), MPI_BYTE, slot / PIPELINE_DEPTH + 1, 0, MPI_COMM_WORLD,
+                &send_requests[slot]);
+      in_flight++;
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  /* signal workers that there is no more work to be done, on every slot */
+  for(slot = 0; slot < n_slots; slot++){
+    MPI_Wait(&send_requests[slot], MPI_STATUS_IGNORE);
+    chunks[slot]->header.n_bytes = -1;
+    MPI_Isend(chunks[slot], sizeof(ChunkHeader), MPI_BYTE, slot / PIPELINE_DEPTH + 1, 0, MPI_COMM_WORLD,
+              &send_requests[slot]);
+  }
+
+  MPI_Waitall(n_slots, send_requests, MPI_STATUSES_IGNORE);
+
+  for(slot = 0; slot < n_slots; slot++){
+    MPI_Request_free(&recv_requests[slot]);
+    free(chunks[slot]);
+  }
+
+  free(chunks);
+  free(results);
+  free(send_requests);
+  free(recv_requests);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
 
 }
 
+/**
+ *  \brief pipelined worker.
+ *
+ *  Keeps PIPELINE_DEPTH persistent receives posted, so the next chunks arrive while the current
+ *  one is processed, and returns each result through a persistent send of its slot.
+ *
+ *  \param rank worker id.
+ */
+
+void pipeline_worker(int rank){
+
+  WireChunk *chunks[PIPELINE_DEPTH];
+  ChunkResult results[PIPELINE_DEPTH];
+  MPI_Request recv_requests[PIPELINE_DEPTH];
+  MPI_Request send_requests[PIPELINE_DEPTH];
+  int slot = 0;
+
+  for(int i = 0; i < PIPELINE_DEPTH; i++){
+    chunks[i] = malloc(WIRE_BYTES(chunk_bytes));
+    MPI_Recv_init(chunks[i], WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &recv_requests[i]);
+    MPI_Send_init(&results[i], sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &send_requests[i]);
+    MPI_Start(&recv_requests[i]);
+  }
+
+  /* chunks arrive in order, one slot after the other */
+  while (true) {
+
+    MPI_Wait(&recv_requests[slot], MPI_STATUS_IGNORE);
+
+    /* if no more work */
+    if(chunks[slot]->header.n_bytes < 0)
+      break;
+
+    /* the previous result of this slot must be sent before its buffer is reused */
+    MPI_Wait(&send_requests[slot], MPI_STATUS_IGNORE);
+
+    /* process chunk */
+    processChunk(chunks[slot]->bytes, chunks[slot]->header.n_bytes, &results[slot]);
+
+    results[slot].file_index = chunks[slot]->header.file_index;
+    results[slot].chunk_index = chunks[slot]->header.chunk_index;
+
+    MPI_Start(&send_requests[slot]);
+    MPI_Start(&recv_requests[slot]);
+
+    slot = (slot + 1) % PIPELINE_DEPTH;
+  }
+
+  /* the other slots also receive the end signal */
+  for(int i = 1; i < PIPELINE_DEPTH; i++)
+    MPI_Wait(&recv_requests[(slot + i) % PIPELINE_DEPTH], MPI_STATUS_IGNORE);
+
+  MPI_Waitall(PIPELINE_DEPTH, send_requests, MPI_STATUSES_IGNORE);
+
+  for(int i = 0; i < PIPELINE_DEPTH; i++){
+    MPI_Request_free(&recv_requests[i]);
+    MPI_Request_free(&send_requests[i]);
+    free(chunks[i]);
+  }
+}
+
+/**
+ *  \brief Check if the process was started by an MPI launcher, such as mpiexec or mpirun.
+ *
+ *  MPI_LAUNCH_ENV set to 1 or 0 forces the answer, for the launchers that set none of the variables
+ *  of Open MPI, MPICH and PMIx in the environment of every process.
+ *
+ *  \return true if started by a launcher, false otherwise.
+ */
+
+static bool launched_by_mpi()
+{
+  char *forced = getenv(MPI_LAUNCH_ENV);
+
+  if (forced != NULL && forced[0] != '\0')
+    return strcmp(forced, "0") != 0;
+
+  return getenv("OMPI_COMM_WORLD_SIZE") != NULL || getenv("PMIX_RANK") != NULL || getenv("PMI_RANK") != NULL ||
+         getenv("PMI_SIZE") != NULL;
+}
+
 /** \brief Prints command usage */
 static void printUsage(char *cmdName)
 {
   fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / positive number]\n"
+                  "  Run with mpiexec and more than one process, or else a single process counts the files with a\n"
+                  "  pool of threads and the scheduling mode is ignored. Set %s=1 under a launcher that is not\n"
+                  "  detected, or %s=0 to run a single process without MPI.\n"
                   "  OPTIONS:\n"
                   "  -h      --- print this help\n"
-                  "  -f      --- filename\n"
-                  "  -n      --- positive number\n",
-          cmdName);
+                  "  -f      --- filename, directory or glob pattern, - for the standard input (default in the stream mode)\n"
+                  "  -n      --- chunk size in bytes (default: %d, %d in the hybrid and blocks modes, %d in the planned mode, %d in the tree mode, %d per worker in the static mode, %d in a single process; smallest size in the adaptive mode)\n"
+                  "  -m      --- scheduling mode: lockstep (default), dynamic, adaptive, pipeline, mpiio, hybrid, stream, local, freq, blocks, shm, planned, tree or static\n"
+                  "  -i      --- seconds between the rolling totals of the stream mode (default: %g)\n"
+                  "  -b      --- bytes between the rolling totals of the stream mode\n"
+                  "  -t      --- threads per worker in the hybrid mode, or of a single process (default: one per online core)\n"
+                  "  -k      --- most frequent words printed for every file in the freq mode (default: %d)\n"
+                  "  -j      --- progress journal, written every -c seconds (lockstep, dynamic, adaptive, pipeline, hybrid, shm and tree modes)\n"
+                  "  -c      --- seconds between two writes of the journal (default: %g)\n"
+                  "  -r      --- --resume, skip the work recorded in the journal\n"
+                  "  -C      --- --cache, result cache of the files that did not change (same modes as -j)\n"
+                  "  -e      --- --emit, when the files are printed: end (default), completion or order (as soon as\n"
+                  "              they and the files before them are complete)\n"
+                  "  -o      --- --format, text (default) or json (one JSON object per line and file)\n",
+          cmdName, MPI_LAUNCH_ENV, MPI_LAUNCH_ENV, NUM_BYTES, HYBRID_BYTES, PLAN_BYTES, TREE_BYTES, STATIC_BYTES, STANDALONE_BYTES, STREAM_INTERVAL, FREQ_TOP_K, JOURNAL_INTERVAL);
 }
 
 /**
@@ -173,21 +788,22 @@ int main(int argc, char *argv[]) {
   
   int rank;
   int size;
+  int provided;
 
   char **file_names;
 
-  /* Initialize MPI */
-  MPI_Init(&argc, &argv);
-  MPI_Comm_size(MPI_COMM_WORLD, &size);
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  /* without a launcher MPI is not started, and the process runs in the standalone mode */
+  bool with_mpi = launched_by_mpi();
 
-  /* Fail if size <= 1 */
-  if(size <= 1){
-    if(rank == 0){
-      printf("Wrong number of processes! It must be greater than 1. \n");
-      MPI_Finalize();
-      return EXIT_FAILURE;
-    }
+  /* Initialize MPI, only the main thread of each process makes MPI calls */
+  if(with_mpi){
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  }
+  else{
+    size = 1;
+    rank = 0;
   }
 
   /* number of workers */
@@ -196,18 +812,23 @@ int main(int argc, char *argv[]) {
   /* if rank = 0 is root */
   if(rank == 0){
     
-    /* allocate memory to save file names */
-    file_names = malloc((argc - 1) * sizeof(char *));
-
     int opt;                                                                                     /* selected option */
     char *fName = "no name";                                     /* file name (initialized to "no name" by default) */
-    int value_opt = -1;                                             /* numeric value (initialized to -1 by default) */
+
+    /* long forms of the options */
+    static struct option long_options[] = {
+      { "resume", no_argument, NULL, 'r' },
+      { "cache", required_argument, NULL, 'C' },
+      { "emit", required_argument, NULL, 'e' },
+      { "format", required_argument, NULL, 'o' },
+      { NULL, 0, NULL, 0 }
+    };
 
     /* Handle command line options */
     do {
-      switch ((opt = getopt(argc, argv, "f:n:h"))) {
+      switch ((opt = getopt_long(argc, argv, "f:n:m:t:i:b:k:j:c:rC:e:o:h", long_options, NULL))) {
         case 'f':                                                                                      /* file name */
-          if (optarg[0] == '-') {
+          if (optarg[0] == '-' && optarg[1] != '\0') {
             fprintf(stderr, "%s: file name is missing\n", basename(argv[0]));
             printUsage(basename(argv[0]));
             return EXIT_FAILURE;
@@ -221,7 +842,126 @@ int main(int argc, char *argv[]) {
             printUsage(basename(argv[0]));
             return EXIT_FAILURE;
           }
-          value_opt = (int)atoi(optarg);
+          chunk_bytes = (int)atoi(optarg);
+          break;
+
+        case 'm':                                                                                /* scheduling mode */
+          if (strcmp(optarg, "lockstep") == 0)
+            mode = MODE_LOCKSTEP;
+          else if (strcmp(optarg, "dynamic") == 0)
+            mode = MODE_DYNAMIC;
+          else if (strcmp(optarg, "adaptive") == 0)
+            mode = MODE_ADAPTIVE;
+          else if (strcmp(optarg, "pipeline") == 0)
+            mode = MODE_PIPELINE;
+          else if (strcmp(optarg, "mpiio") == 0)
+            mode = MODE_MPIIO;
+          else if (strcmp(optarg, "hybrid") == 0)
+            mode = MODE_HYBRID;
+          else if (strcmp(optarg, "stream") == 0)
+            mode = MODE_STREAM;
+          else if (strcmp(optarg, "local") == 0)
+            mode = MODE_LOCAL;
+          else if (strcmp(optarg, "freq") == 0)
+            mode = MODE_FREQ;
+          else if (strcmp(optarg, "blocks") == 0)
+            mode = MODE_BLOCKS;
+          else if (strcmp(optarg, "shm") == 0)
+            mode = MODE_SHM;
+          else if (strcmp(optarg, "planned") == 0)
+            mode = MODE_PLANNED;
+          else if (strcmp(optarg, "tree") == 0)
+            mode = MODE_TREE;
+          else if (strcmp(optarg, "static") == 0)
+            mode = MODE_STATIC;
+          else {
+            fprintf(stderr, "%s: unknown scheduling mode\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          break;
+
+        case 't':                                                                              /* number of threads */
+          if (atoi(optarg) <= 0) {
+            fprintf(stderr, "%s: non positive number of threads\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          n_threads = (int)atoi(optarg);
+          break;
+
+        case 'i':                                                                  /* seconds between rolling totals */
+          if (atof(optarg) <= 0) {
+            fprintf(stderr, "%s: non positive interval\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          report_interval = atof(optarg);
+          break;
+
+        case 'b':                                                                    /* bytes between rolling totals */
+          if (atoll(optarg) <= 0) {
+            fprintf(stderr, "%s: non positive number of bytes\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          report_bytes = atoll(optarg);
+          break;
+
+        case 'k':                                                                   /* number of most frequent words */
+          if (atoi(optarg) <= 0) {
+            fprintf(stderr, "%s: non positive number of words\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          top_k = (int)atoi(optarg);
+          break;
+
+        case 'j':                                                                               /* progress journal */
+          journal = optarg;
+          break;
+
+        case 'c':                                                               /* seconds between journal writes */
+          if (atof(optarg) <= 0) {
+            fprintf(stderr, "%s: non positive interval\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          checkpoint_interval = atof(optarg);
+          break;
+
+        case 'r':                                                                                         /* resume */
+          resume = 1;
+          break;
+
+        case 'C':                                                                                   /* result cache */
+          cache = optarg;
+          break;
+
+        case 'e':                                                                         /* when files are printed */
+          if (strcmp(optarg, "completion") == 0)
+            output_when = EMIT_COMPLETION;
+          else if (strcmp(optarg, "order") == 0)
+            output_when = EMIT_ORDER;
+          else if (strcmp(optarg, "end") == 0)
+            output_when = EMIT_END;
+          else {
+            fprintf(stderr, "%s: unknown emission %s\n", basename(argv[0]), optarg);
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
+          break;
+
+        case 'o':                                                                                  /* output format */
+          if (strcmp(optarg, "json") == 0)
+            output_json = 1;
+          else if (strcmp(optarg, "text") == 0)
+            output_json = 0;
+          else {
+            fprintf(stderr, "%s: unknown format %s\n", basename(argv[0]), optarg);
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+          }
           break;
 
         case 'h':                                                                                      /* help mode */
@@ -247,23 +987,169 @@ int main(int argc, char *argv[]) {
     }
 
 
-    /* Save filenames */
-    for (int i = 2; i < argc; i++){
-      file_names[i - 2] = argv[i];
+    /* the streaming mode reads the standard input by default */
+    if (strcmp(fName, "no name") == 0 && mode == MODE_STREAM)
+      fName = "-";
+
+    if (strcmp(fName, "no name") == 0) {
+      fprintf(stderr, "%s: file name is missing\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    /* Save filenames: the -f argument followed by the remaining non-option arguments, with the
+       directories and glob patterns expanded */
+    int num_files = 0, max_files = 0;
+    file_names = NULL;
+    expand_input(fName, &file_names, &num_files, &max_files);
+    for (int i = optind; i < argc; i++){
+      expand_input(argv[i], &file_names, &num_files, &max_files);
+    }
+
+    if (num_files == 0) {
+      fprintf(stderr, "%s: no files to count\n", basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    /* a single process counts the files on its own, whatever the mode */
+    if (size == 1) {
+      if (mode == MODE_FREQ) {
+        fprintf(stderr, "%s: the freq mode needs more than one process\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      mode = MODE_STANDALONE;
     }
 
+    if (chunk_bytes == 0)
+      chunk_bytes = mode == MODE_HYBRID ? HYBRID_BYTES : mode == MODE_BLOCKS ? BLOCK_BYTES :
+                    mode == MODE_PLANNED ? PLAN_BYTES :
+                    mode == MODE_TREE ? TREE_BYTES :
+                    mode == MODE_STATIC ? STATIC_BYTES :
+                    mode == MODE_STANDALONE ? STANDALONE_BYTES : NUM_BYTES;
+
+    /* the journal and the cache need the root to read the files and merge the chunks in order */
+    if (resume && journal == NULL) {
+      fprintf(stderr, "%s: --resume needs a journal\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+
+    if (journal != NULL || cache != NULL) {
+      if (mode != MODE_LOCKSTEP && mode != MODE_DYNAMIC && mode != MODE_ADAPTIVE && mode != MODE_PIPELINE &&
+          mode != MODE_HYBRID && mode != MODE_SHM && mode != MODE_TREE && mode != MODE_STANDALONE) {
+        fprintf(stderr, "%s: the journal and the cache are not supported in this mode\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+      }
+      if (journal != NULL)
+        set_journal(journal, checkpoint_interval, resume);
+      if (cache != NULL)
+        set_cache(cache);
+    }
+
+#if METRICS
+    /* the metrics travel in the chunk results, which these modes, the journal and the cache do not keep */
+    if (mode == MODE_LOCAL || mode == MODE_FREQ || mode == MODE_STATIC || journal != NULL || cache != NULL) {
+      fprintf(stderr, "%s: the metrics are not supported in this mode, nor with the journal or the cache\n",
+              basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+#endif
+
+    /* the word frequency mode prints its own results */
+    if (mode == MODE_FREQ && (output_when != EMIT_END || output_json)) {
+      fprintf(stderr, "%s: the emission and the format are not supported in the freq mode\n", basename(argv[0]));
+      printUsage(basename(argv[0]));
+      return EXIT_FAILURE;
+    }
+    set_output(output_when, output_json);
+
+    if (mode == MODE_STREAM && report_interval == 0 && report_bytes == 0)
+      report_interval = STREAM_INTERVAL;
+
+    /* share the settings with the workers */
+    int settings[4] = { mode, n_threads, chunk_bytes, top_k };
+    if (mode != MODE_STANDALONE)
+      MPI_Bcast(settings, 4, MPI_INT, 0, MPI_COMM_WORLD);
+
     /* run the dispatcher */
-    dispatcher(file_names, argc - 2);
+    if (mode == MODE_STANDALONE)
+      standalone_dispatcher(file_names, num_files, n_threads, chunk_bytes);
+    else if (mode == MODE_HYBRID)
+      hybrid_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_MPIIO)
+      mpiio_dispatcher(file_names, num_files);
+    else if (mode == MODE_PIPELINE)
+      pipeline_dispatcher(file_names, num_files);
+    else if (mode == MODE_DYNAMIC || mode == MODE_ADAPTIVE)
+      dynamic_dispatcher(file_names, num_files);
+    else if (mode == MODE_STREAM)
+      stream_dispatcher(file_names, num_files);
+    else if (mode == MODE_LOCAL)
+      local_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_FREQ)
+      freq_dispatcher(file_names, num_files, chunk_bytes, top_k);
+    else if (mode == MODE_BLOCKS)
+      blocks_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_SHM)
+      shm_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_PLANNED)
+      planned_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_TREE)
+      tree_dispatcher(file_names, num_files, chunk_bytes);
+    else if (mode == MODE_STATIC)
+      static_dispatcher(file_names, num_files, chunk_bytes);
+    else
+      dispatcher(file_names, num_files);
 
   }
   
   /* if rank > 0, is a worker */
   else{
+    /* get the settings chosen by the root */
+    int settings[4];
+    MPI_Bcast(settings, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    mode = settings[0];
+    n_threads = settings[1];
+    chunk_bytes = settings[2];
+    top_k = settings[3];
+
+    /* without thread support, the team is reduced to the main thread */
+    if (mode == MODE_HYBRID && provided < MPI_THREAD_FUNNELED) {
+      if (rank == 1)
+        fprintf(stderr, "MPI does not support threads, the workers run single threaded\n");
+      n_threads = 1;
+    }
+
     /* run the worker */
-    worker(rank);
+    if (mode == MODE_HYBRID)
+      hybrid_worker(rank, n_threads, chunk_bytes);
+    else if (mode == MODE_LOCAL)
+      local_worker(rank, chunk_bytes);
+    else if (mode == MODE_FREQ)
+      freq_worker(rank, chunk_bytes, top_k);
+    else if (mode == MODE_BLOCKS)
+      blocks_worker(rank);
+    else if (mode == MODE_SHM)
+      shm_worker(rank, chunk_bytes);
+    else if (mode == MODE_PLANNED)
+      planned_worker(rank);
+    else if (mode == MODE_TREE)
+      tree_worker(rank, chunk_bytes);
+    else if (mode == MODE_STATIC)
+      static_worker(rank, chunk_bytes);
+    else if (mode == MODE_MPIIO)
+      mpiio_worker(rank);
+    else if (mode == MODE_PIPELINE)
+      pipeline_worker(rank);
+    else
+      worker(rank);
   }
 
-  MPI_Finalize();
+  if(with_mpi)
+    MPI_Finalize();
   return 0;
 }
 
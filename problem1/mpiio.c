@@ -0,0 +1,216 @@
+/**
+ *  \file mpiio.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Parallel reading mode. The root only shares the file names and gathers the final totals, while
+ *  every worker opens the files with MPI-IO and reads its own byte range of each one. The partial
+ *  results of the ranges keep the state at their boundaries, so the words that cross from one
+ *  worker to the next are settled by a reduction that merges the results in rank order.
+ *
+ *  Definition of the operations:
+ *     \li share_file_names
+ *     \li mpiio_dispatcher
+ *     \li mpiio_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "partialResult.h"
+#include "mpiio.h"
+
+/** 
+ *  \brief Broadcast the file names from the root to the workers.
+ * 
+ *  \param file_names array with the file names, allocated on the workers.
+ *  \param num_files number of files, set on the workers.
+ */
+
+void share_file_names(char ***file_names, int *num_files) {
+
+  int rank, length;
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Bcast(num_files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (rank != 0)
+    *file_names = malloc(*num_files * sizeof(char *));
+
+  for (int i = 0; i < *num_files; i++) {
+    if (rank == 0)
+      length = strlen((*file_names)[i]) + 1;
+
+    MPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (rank != 0)
+      (*file_names)[i] = malloc(length);
+
+    MPI_Bcast((*file_names)[i], length, MPI_CHAR, 0, MPI_COMM_WORLD);
+  }
+}
+
+/** 
+ *  \brief Count the words of this worker's byte range of a file.
+ * 
+ *  \param fh file handle, opened over the workers communicator.
+ *  \param comm workers communicator.
+ *  \param result partial results of the range.
+ */
+
+static void count_range(MPI_File fh, MPI_Comm comm, ChunkResult *result) {
+
+  int w, nw, parts, n;
+  MPI_Offset size, range, lo, hi, offset;
+  ChunkResult block_result;
+
+  MPI_Comm_rank(comm, &w);
+  MPI_Comm_size(comm, &nw);
+  MPI_File_get_size(fh, &size);
+
+  /* split the file in ranges of at least MPIIO_MIN_RANGE bytes, one per worker */
+  parts = size / MPIIO_MIN_RANGE;
+  if (parts > nw)
+    parts = nw;
+  if (parts < 1)
+    parts = 1;
+
+  range = (size + parts - 1) / parts;
+  lo = w < parts ? w * range : size;
+  hi = lo + range < size ? lo + range : size;
+
+  unsigned char *buf = malloc(MPIIO_BLOCK);
+
+  /* read and process the range one block at a time, merging the results in order */
+  for (offset = lo; offset < hi; offset += n) {
+    n = hi - offset < MPIIO_BLOCK ? hi - offset : MPIIO_BLOCK;
+    MPI_File_read_at(fh, offset, buf, n, MPI_BYTE, MPI_STATUS_IGNORE);
+
+    processChunk(buf, n, &block_result);
+    result_merge(result, &block_result, result);
+  }
+
+  free(buf);
+}
+
+/**
+ *  \brief parallel reading dispatcher.
+ *
+ *  Shares the file names with the workers, waits for the reduction of the per-file counters and
+ *  prints the final results.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ */
+
+void mpiio_dispatcher(char *file_names[], unsigned int num_files) {
+
+  struct timespec start, finish;
+  int n_files = num_files;
+  MPI_Comm comm;
+  MPI_Datatype result_type;
+  MPI_Op merge_op;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  share_file_names(&file_names, &n_files);
+
+  /* the root is not part of the workers communicator */
+  MPI_Comm_split(MPI_COMM_WORLD, MPI_UNDEFINED, 0, &comm);
+
+  /* the root comes first in rank order, with empty results */
+  ChunkResult *results = malloc(n_files * sizeof(ChunkResult));
+
+  for (int i = 0; i < n_files; i++)
+    result_init(&results[i], i);
+
+  MPI_Type_contiguous(sizeof(ChunkResult), MPI_BYTE, &result_type);
+  MPI_Type_commit(&result_type);
+  MPI_Op_create(result_merge_op, 0, &merge_op);
+
+  MPI_Reduce(MPI_IN_PLACE, results, n_files, result_type, merge_op, 0, MPI_COMM_WORLD);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  /* save results of each file */
+  for (int i = 0; i < n_files; i++)
+    save_file_results(&results[i]);
+
+  free(results);
+  MPI_Op_free(&merge_op);
+  MPI_Type_free(&result_type);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief parallel reading worker.
+ *
+ *  Opens every file with MPI-IO, counts the words of its own byte range and takes part in the
+ *  final reduction of the per-file results.
+ *
+ *  \param rank worker id.
+ */
+
+void mpiio_worker(int rank) {
+
+  char **file_names = NULL;
+  int num_files;
+  MPI_Comm comm;
+  MPI_File fh;
+  MPI_Datatype result_type;
+  MPI_Op merge_op;
+
+  share_file_names(&file_names, &num_files);
+
+  MPI_Comm_split(MPI_COMM_WORLD, 0, rank, &comm);
+
+  ChunkResult *results = malloc(num_files * sizeof(ChunkResult));
+
+  for (int i = 0; i < num_files; i++) {
+
+    result_init(&results[i], i);
+
+    if (MPI_File_open(comm, file_names[i], MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+      if (rank == 1)
+        fprintf(stderr, "Could not open file %s\n", file_names[i]);
+      continue;
+    }
+
+    count_range(fh, comm, &results[i]);
+
+    MPI_File_close(&fh);
+  }
+
+  MPI_Type_contiguous(sizeof(ChunkResult), MPI_BYTE, &result_type);
+  MPI_Type_commit(&result_type);
+  MPI_Op_create(result_merge_op, 0, &merge_op);
+
+  MPI_Reduce(results, NULL, num_files, result_type, merge_op, 0, MPI_COMM_WORLD);
+
+  MPI_Op_free(&merge_op);
+  MPI_Type_free(&result_type);
+
+  for (int i = 0; i < num_files; i++)
+    free(file_names[i]);
+
+  free(file_names);
+  free(results);
+  MPI_Comm_free(&comm);
+}
@@ -0,0 +1,27 @@
+/**
+ *  \file mpiio.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the parallel reading mode, where the workers read the files
+ *  themselves with MPI-IO:
+ *     \li share_file_names
+ *     \li mpiio_dispatcher
+ *     \li mpiio_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef MPIIO_H_
+#define MPIIO_H_
+
+/** \brief Broadcast the file names from the root to the workers */
+extern void share_file_names(char ***file_names, int *num_files);
+
+/** \brief Share the file names with the workers and gather the final results */
+extern void mpiio_dispatcher(char *file_names[], unsigned int num_files);
+
+/** \brief Read and process this worker's byte range of every file */
+extern void mpiio_worker(int rank);
+
+#endif /* MPIIO_H_ */
@@ -0,0 +1,489 @@
+/**
+ *  \file partialResult.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Operations on the partial results of chunks. The result of a chunk counts the words that lie
+ *  inside it and keeps the state at its boundaries: the leading apostrophes and first char, the
+ *  class of the last char, and the bytes of chars cut by the chunk boundaries. Merging two
+ *  consecutive results counts the words that cross the boundary between them, and it is
+ *  associative, so the chunks of a file can be merged in any grouping, as long as their order in
+ *  the file is kept.
+ *
+ *  Definition of the operations:
+ *     \li result_init
+ *     \li result_merge
+ *     \li result_finish
+ *     \li result_metrics
+ *     \li result_merge_op
+ *     \li result_to_ack
+ *     \li result_from_ack.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <string.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "worker.h"
+#include "utf8.h"
+#include "partialResult.h"
+
+/** 
+ *  \brief Initialize the result of an empty chunk.
+ * 
+ *  \param result result to be initialized.
+ *  \param file_index index of the file of the chunk.
+ */
+
+void result_init(ChunkResult *result, int file_index) {
+  memset(result, 0, sizeof(ChunkResult));
+  result->file_index = file_index;
+  result->first_class = CLASS_NONE;
+  result->last_class = CLASS_NONE;
+}
+
+/** 
+ *  \brief Check if a result has no complete chars.
+ * 
+ *  \param result result to be checked.
+ *  \return 1 if it has no chars, 0 otherwise.
+ */
+
+static int no_chars(const ChunkResult *result) {
+  return result->lead_apostrophes == 0 && result->first_class == CLASS_NONE;
+}
+
+/** 
+ *  \brief Count the words completed by the first chars of a result, given the char before them.
+ * 
+ *  \param right result that follows the char.
+ *  \param class_before class of the char before the result.
+ *  \param merged result whose counters are incremented.
+ */
+
+static void count_boundary(const ChunkResult *right, int class_before, ChunkResult *merged) {
+
+  int first = right->first_class;
+
+  if (first == CLASS_NONE)
+    return;
+
+  /* leading apostrophes are skipped after a split char and are plain chars otherwise */
+  if (right->lead_apostrophes > 0 && !(class_before & CLASS_SPLIT))
+    class_before = CLASS_APOSTROPHE;
+
+  /* first char of a word that is a vowel */
+  if ((first & CLASS_VOWEL) && (class_before & CLASS_SPLIT))
+    merged->num_vowels += 1;
+
+  /* word ending with a consonant */
+  if ((first & CLASS_SPLIT) && (class_before & CLASS_CONSONANT))
+    merged->num_cons += 1;
+
+  /* end of word */
+  if ((first & CLASS_SPLIT) && !(class_before & (CLASS_SPLIT | CLASS_ZERO)))
+    merged->num_words += 1;
+}
+
+#if METRICS
+/** 
+ *  \brief Merge the metrics of a result into the result that precedes it.
+ *
+ *  The totals are added. The word cut between the two results is the word still open at the end
+ *  of left followed by the chars of right before its first split char, its leading apostrophes
+ *  only counting when left does not end in a split char. It is counted when that split char ends
+ *  a word, as for the counter of words.
+ * 
+ *  \param left first result, which receives the merged metrics.
+ *  \param right result that follows it, with some chars.
+ */
+
+static void merge_metrics(ChunkResult *left, const ChunkResult *right) {
+
+  Metrics *merged = &left->metrics;
+  const Metrics *next = &right->metrics;
+
+#if METRICS & METRIC_CLASSES
+  for (int i = 0; i < METRIC_N_CLASSES; i++)
+    merged->classes[i] += next->classes[i];
+#endif
+
+#if METRICS & METRIC_LINES
+  merged->lines += next->lines;
+#endif
+
+#if METRICS & METRIC_LENGTHS
+  for (int i = 0; i <= METRIC_MAX_LENGTH; i++)
+    merged->lengths[i] += next->lengths[i];
+  merged->length_total += next->length_total;
+
+  /* if left only has apostrophes, they are part of the leading apostrophes of right */
+  if (left->first_class == CLASS_NONE) {
+    merged->head_length = next->head_length;
+    merged->tail_length = next->tail_length;
+    merged->head_ends = next->head_ends;
+    merged->head_zero = next->head_zero;
+    return;
+  }
+
+  long long apostrophes = (left->last_class & CLASS_SPLIT) ? 0 : right->lead_apostrophes;
+  long long open = merged->head_ends ? merged->tail_length : merged->head_length;
+  long long length = open + apostrophes + next->head_length;
+
+  /* the char before the first split char of right is in right, an apostrophe or the last char of left */
+  int counted = next->head_length > 0 ? !next->head_zero :
+                apostrophes > 0 ? 1 : !(left->last_class & (CLASS_SPLIT | CLASS_ZERO));
+
+  if (!next->head_ends) {
+    if (merged->head_ends)
+      merged->tail_length = length;
+    else
+      merged->head_length = merged->tail_length = length;
+  }
+  else if (merged->head_ends) {
+    if (counted) {
+      merged->lengths[length < METRIC_MAX_LENGTH ? length : METRIC_MAX_LENGTH] += 1;
+      merged->length_total += length;
+    }
+    merged->tail_length = next->tail_length;
+  }
+  else {
+    /* the first word of left ends in right */
+    merged->head_ends = 1;
+    merged->head_length = length;
+    merged->head_zero = !counted;
+    merged->tail_length = next->tail_length;
+  }
+#endif
+}
+#endif
+
+/** 
+ *  \brief Merge the chars of a result into the result that precedes it, ignoring the bytes of cut chars.
+ * 
+ *  \param left first result, which receives the merged chars.
+ *  \param right result that follows it.
+ */
+
+static void merge_chars(ChunkResult *left, const ChunkResult *right) {
+
+  if (no_chars(right))
+    return;
+
+#if METRICS
+  merge_metrics(left, right);
+#endif
+
+  /* if left only has apostrophes, they are part of the leading apostrophes of right */
+  if (left->first_class == CLASS_NONE) {
+    left->lead_apostrophes += right->lead_apostrophes;
+    left->first_class = right->first_class;
+    left->last_class = right->last_class;
+    left->num_words = right->num_words;
+    left->num_vowels = right->num_vowels;
+    left->num_cons = right->num_cons;
+    return;
+  }
+
+  left->num_words += right->num_words;
+  left->num_vowels += right->num_vowels;
+  left->num_cons += right->num_cons;
+
+  count_boundary(right, left->last_class, left);
+
+  /* if right only has apostrophes, they take the place of the last char */
+  if (right->first_class != CLASS_NONE)
+    left->last_class = right->last_class;
+  else if (!(left->last_class & CLASS_SPLIT))
+    left->last_class = CLASS_APOSTROPHE;
+}
+
+/** 
+ *  \brief Merge a result with a single char.
+ * 
+ *  \param result result to be extended.
+ *  \param bytes bytes of the char.
+ */
+
+static void merge_char(ChunkResult *result, const unsigned char *bytes) {
+
+  ChunkResult single;
+
+#if METRICS
+  /* the char is counted as a chunk, to have its metrics */
+  processChunk(bytes, utf8_length(bytes[0]), &single);
+#else
+  int pos = 0;
+  int ch_value = utf8_decode(bytes, utf8_length(bytes[0]), &pos);
+
+  result_init(&single, result->file_index);
+
+  if (char_class(ch_value) & CLASS_APOSTROPHE)
+    single.lead_apostrophes = 1;
+  else
+    single.first_class = single.last_class = boundary_class(ch_value);
+#endif
+
+  merge_chars(result, &single);
+}
+
+/** 
+ *  \brief Merge a result with chars that could not be decoded, each one a UTF8_REPLACEMENT.
+ * 
+ *  \param result result to be extended.
+ *  \param count number of chars.
+ */
+
+static void merge_replacements(ChunkResult *result, int count) {
+
+  unsigned char bytes[4];
+
+  utf8_encode(UTF8_REPLACEMENT, bytes);
+
+  for (int i = 0; i < count; i++)
+    merge_char(result, bytes);
+}
+
+/** 
+ *  \brief Merge the results of two consecutive pieces of a file.
+ *
+ *  The bytes of a char cut between the two pieces are joined back and walked through the decoder
+ *  automaton, as a pass over the whole file would do. The head bytes of right that complete the
+ *  tail bytes of left are merged as one char in between them. A start of a char that the next byte
+ *  rejects, and the head bytes that nothing before them starts, are merged as UTF8_REPLACEMENT,
+ *  one for each.
+ * 
+ *  \param left result of the first piece.
+ *  \param right result of the piece that follows it.
+ *  \param merged merged result, which may be the same as left or right.
+ */
+
+void result_merge(const ChunkResult *left, const ChunkResult *right, ChunkResult *merged) {
+
+  ChunkResult result = *left;
+  ChunkResult rest = *right;
+  unsigned char bytes[6];
+  int n_bytes, used, stray;
+
+  /* the chars of right, once its head bytes are settled */
+  rest.n_head_bytes = 0;
+
+  /* if left only has the end of a char, it goes before the head bytes of right */
+  if (no_chars(left) && left->n_tail_bytes == 0) {
+    n_bytes = left->n_head_bytes;
+    memcpy(bytes, left->head_bytes, n_bytes);
+    memcpy(bytes + n_bytes, right->head_bytes, right->n_head_bytes);
+    n_bytes += right->n_head_bytes;
+
+    /* a char starts with 3 continuation bytes at most, the others cannot be part of it */
+    used = n_bytes < 3 ? n_bytes : 3;
+    memcpy(result.head_bytes, bytes, used);
+    result.n_head_bytes = used;
+    stray = n_bytes - used;
+  }
+
+  else {
+
+    /* bytes of the char cut between the two pieces */
+    int state = UTF8_ACCEPT, ch_value;
+
+    n_bytes = left->n_tail_bytes;
+    memcpy(bytes, left->tail_bytes, n_bytes);
+    for (int i = 0; i < n_bytes; i++)
+      state = utf8_step(state, &ch_value, bytes[i]);
+
+    used = 0;
+    while (n_bytes > 0 && state != UTF8_ACCEPT && state != UTF8_REJECT && used < right->n_head_bytes) {
+      bytes[n_bytes++] = right->head_bytes[used++];
+      state = utf8_step(state, &ch_value, bytes[n_bytes - 1]);
+    }
+
+    result.n_tail_bytes = 0;
+
+    if (n_bytes > 0 && state == UTF8_ACCEPT)
+      merge_char(&result, bytes);
+
+    /* the byte that rejects the char starts the next one */
+    else if (n_bytes > 0 && state == UTF8_REJECT) {
+      used -= used > 0;
+      merge_replacements(&result, 1);
+    }
+
+    /* if right only has the end of a char, the cut char may still be completed */
+    else if (n_bytes > 0 && no_chars(right) && right->n_tail_bytes == 0) {
+      memcpy(result.tail_bytes, bytes, n_bytes);
+      result.n_tail_bytes = n_bytes;
+    }
+
+    else if (n_bytes > 0)
+      merge_replacements(&result, 1);
+
+    stray = right->n_head_bytes - used;
+  }
+
+  merge_replacements(&result, stray);
+  merge_chars(&result, &rest);
+
+  if (!(no_chars(right) && right->n_tail_bytes == 0)) {
+    memcpy(result.tail_bytes, right->tail_bytes, right->n_tail_bytes);
+    result.n_tail_bytes = right->n_tail_bytes;
+  }
+
+  result.n_bytes = left->n_bytes + right->n_bytes;
+  result.file_index = left->file_index;
+  result.chunk_index = left->chunk_index;
+
+  /* merged may be left, so it is only written once left was read */
+  *merged = result;
+}
+
+/** 
+ *  \brief Decode the head bytes at the start of a file, which no char before them starts.
+ * 
+ *  \param result merged result of all the chunks of the file.
+ *  \param whole result with the head bytes merged as UTF8_REPLACEMENT.
+ */
+
+static void settle_head(const ChunkResult *result, ChunkResult *whole) {
+
+  ChunkResult rest = *result;
+
+  if (result->n_head_bytes == 0) {
+    *whole = *result;
+    return;
+  }
+
+  rest.n_head_bytes = 0;
+
+  result_init(whole, result->file_index);
+  merge_replacements(whole, result->n_head_bytes);
+  result_merge(whole, &rest, whole);
+}
+
+/** 
+ *  \brief Get the final counters of a whole file from its merged result.
+ * 
+ *  \param file_result merged result of all the chunks of the file.
+ *  \param num_words total number of words.
+ *  \param num_vowels number of words beginning with a vowel.
+ *  \param num_cons number of words ending with a consonant.
+ */
+
+void result_finish(const ChunkResult *file_result, long long *num_words, long long *num_vowels, long long *num_cons) {
+
+  ChunkResult whole, finished;
+
+  settle_head(file_result, &whole);
+
+  result_init(&finished, whole.file_index);
+
+  /* the file starts as if the char before it was 0 */
+  count_boundary(&whole, CLASS_ZERO, &finished);
+
+  /* check if first char of file is vowel */
+  if (whole.lead_apostrophes == 0 && whole.first_class != CLASS_NONE && (whole.first_class & CLASS_VOWEL))
+    finished.num_vowels += 1;
+
+  *num_words = whole.num_words + finished.num_words;
+  *num_vowels = whole.num_vowels + finished.num_vowels;
+  *num_cons = whole.num_cons + finished.num_cons;
+}
+
+#if METRICS
+/** 
+ *  \brief Get the final metrics of a whole file from its merged result.
+ *
+ *  The file starts as if the char before it was 0, so its leading apostrophes are chars of its
+ *  first word.
+ * 
+ *  \param file_result merged result of all the chunks of the file.
+ *  \param metrics final metrics.
+ */
+
+void result_metrics(const ChunkResult *file_result, Metrics *metrics) {
+
+  ChunkResult whole;
+
+  settle_head(file_result, &whole);
+
+  *metrics = whole.metrics;
+
+#if METRICS & METRIC_LENGTHS
+  long long length = whole.lead_apostrophes + metrics->head_length;
+  int counted = metrics->head_length > 0 ? !metrics->head_zero : whole.lead_apostrophes > 0;
+
+  if (whole.first_class != CLASS_NONE && metrics->head_ends && counted) {
+    metrics->lengths[length < METRIC_MAX_LENGTH ? length : METRIC_MAX_LENGTH] += 1;
+    metrics->length_total += length;
+  }
+#endif
+}
+#endif
+
+/** 
+ *  \brief MPI reduction operation that merges arrays of results.
+ *
+ *  For a non commutative operation, MPI passes in the results of the lower ranks, so each element
+ *  of inout becomes in merged with inout.
+ * 
+ *  \param in results of the lower ranks.
+ *  \param inout results of the higher ranks, replaced by the merged results.
+ *  \param len number of results.
+ *  \param datatype datatype of one result.
+ */
+
+void result_merge_op(void *in, void *inout, int *len, MPI_Datatype *datatype) {
+
+  ChunkResult *left = (ChunkResult *) in;
+  ChunkResult *right = (ChunkResult *) inout;
+
+  for (int i = 0; i < *len; i++)
+    result_merge(&left[i], &right[i], &right[i]);
+}
+
+/** 
+ *  \brief Keep only the state at the boundaries of a result.
+ *
+ *  The counters of a merged result are the sum of the counters of its pieces plus the words
+ *  settled at their boundaries, so the counters can be summed apart and the boundaries merged
+ *  from the acks alone. The ack covers the single chunk of the result.
+ * 
+ *  \param result result of a chunk.
+ *  \param ack state at the boundaries of the chunk.
+ */
+
+void result_to_ack(const ChunkResult *result, ChunkAck *ack) {
+  ack->file_index = result->file_index;
+  ack->chunk_index = result->chunk_index;
+  ack->n_chunks = 1;
+  ack->lead_apostrophes = result->lead_apostrophes;
+  ack->first_class = result->first_class;
+  ack->last_class = result->last_class;
+  ack->n_head_bytes = result->n_head_bytes;
+  ack->n_tail_bytes = result->n_tail_bytes;
+  memcpy(ack->head_bytes, result->head_bytes, 3);
+  memcpy(ack->tail_bytes, result->tail_bytes, 3);
+}
+
+/** 
+ *  \brief Rebuild a result with no counters from the state at its boundaries.
+ * 
+ *  \param ack state at the boundaries of a chunk.
+ *  \param result result of the chunk, with all counters at 0.
+ */
+
+void result_from_ack(const ChunkAck *ack, ChunkResult *result) {
+  result_init(result, ack->file_index);
+  result->chunk_index = ack->chunk_index;
+  result->lead_apostrophes = ack->lead_apostrophes;
+  result->first_class = ack->first_class;
+  result->last_class = ack->last_class;
+  result->n_head_bytes = ack->n_head_bytes;
+  result->n_tail_bytes = ack->n_tail_bytes;
+  memcpy(result->head_bytes, ack->head_bytes, 3);
+  memcpy(result->tail_bytes, ack->tail_bytes, 3);
+}
@@ -0,0 +1,48 @@
+/**
+ *  \file partialResult.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations on the partial results of chunks:
+ *     \li result_init
+ *     \li result_merge
+ *     \li result_finish
+ *     \li result_metrics
+ *     \li result_merge_op
+ *     \li result_to_ack
+ *     \li result_from_ack.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <mpi.h>
+
+#include "MessageStruct.h"
+
+#ifndef PARTIALRESULT_H_
+#define PARTIALRESULT_H_
+
+/** \brief Initialize the result of an empty chunk */
+extern void result_init(ChunkResult *result, int file_index);
+
+/** \brief Merge the results of two consecutive pieces of a file */
+extern void result_merge(const ChunkResult *left, const ChunkResult *right, ChunkResult *merged);
+
+/** \brief Get the final counters of a whole file */
+extern void result_finish(const ChunkResult *result, long long *num_words, long long *num_vowels, long long *num_cons);
+
+#if METRICS
+/** \brief Get the final metrics of a whole file */
+extern void result_metrics(const ChunkResult *result, Metrics *metrics);
+#endif
+
+/** \brief MPI reduction operation that merges arrays of results in rank order */
+extern void result_merge_op(void *in, void *inout, int *len, MPI_Datatype *datatype);
+
+/** \brief Keep only the state at the boundaries of a result */
+extern void result_to_ack(const ChunkResult *result, ChunkAck *ack);
+
+/** \brief Rebuild a result with no counters from the state at its boundaries */
+extern void result_from_ack(const ChunkAck *ack, ChunkResult *result);
+
+#endif /* PARTIALRESULT_H_ */
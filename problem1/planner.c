@@ -0,0 +1,531 @@
+/**
+ *  \file planner.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Input expansion and planned mode.
+ *
+ *  An input may be a file, a directory, whose regular files are taken recursively in name order,
+ *  or a glob pattern, so a corpus too large for the command line can be given in one argument.
+ *
+ *  In the planned mode the dispatcher stats all the files before starting. Every file is cut into
+ *  full chunks and a smaller remainder, which is the whole file when it is smaller than a chunk.
+ *  Each full chunk is a work item, while the remainders are packed into work items of up to a
+ *  chunk, so many small files cost one message, and the worker sends back one result per piece.
+ *  The work items are handed out on demand, those of the largest files first and the packed
+ *  remainders, from the largest to the smallest, last (longest processing time first), so the
+ *  small items even out the finish of the workers.
+ *
+ *  Definition of the operations:
+ *     \li expand_input
+ *     \li planned_dispatcher
+ *     \li planned_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "planner.h"
+
+/** \brief piece of a file, a full chunk or the remainder after the full chunks */
+typedef struct {
+  int file_index;
+  int chunk_index;
+  long long offset;
+  int n_bytes;
+} Piece;
+
+/** \brief work item: consecutive pieces of the plan */
+typedef struct {
+  int first;
+  int n_pieces;
+} WorkItem;
+
+/** \brief header of a work item on the wire, followed by the headers of its pieces and their bytes */
+typedef struct {
+  int n_pieces;                   /* -1 tells the worker to stop */
+} ItemHeader;
+
+/** \brief work items and their pieces, in the order they are handed out */
+typedef struct {
+  Piece *pieces;
+  int n_pieces;
+  WorkItem *items;
+  int n_items;
+} Plan;
+
+/**
+ *  \brief Add a name to the file names.
+ */
+
+static void add_name(const char *name, char ***file_names, int *num_files, int *max_files) {
+
+  if (*num_files == *max_files) {
+    *max_files = *max_files ? 2 * *max_files : 64;
+    *file_names = realloc(*file_names, *max_files * sizeof(char *));
+  }
+
+  (*file_names)[(*num_files)++] = strdup(name);
+}
+
+/**
+ *  \brief Order names alphabetically.
+ */
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ *  \brief Add the regular files under a directory, in name order.
+ */
+
+static void add_directory(const char *path, char ***file_names, int *num_files, int *max_files) {
+
+  DIR *dir;
+  struct dirent *entry;
+  struct stat st;
+  char **names = NULL;
+  int n_names = 0, max_names = 0;
+
+  if ((dir = opendir(path)) == NULL) {
+    fprintf(stderr, "Could not open directory %s: %s\n", path, strerror(errno));
+    return;
+  }
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    char *name = malloc(strlen(path) + strlen(entry->d_name) + 2);
+    sprintf(name, "%s/%s", path, entry->d_name);
+    add_name(name, &names, &n_names, &max_names);
+    free(name);
+  }
+
+  closedir(dir);
+
+  qsort(names, n_names, sizeof(char *), compare_names);
+
+  for (int i = 0; i < n_names; i++) {
+    if (stat(names[i], &st) == 0 && S_ISDIR(st.st_mode))
+      add_directory(names[i], file_names, num_files, max_files);
+    else if (stat(names[i], &st) == 0 && S_ISREG(st.st_mode))
+      add_name(names[i], file_names, num_files, max_files);
+    free(names[i]);
+  }
+
+  free(names);
+}
+
+/**
+ *  \brief Add a file, the files under a directory or the files matched by a glob pattern to the
+ *  file names.
+ *
+ *  A pattern is only expanded when no file has its name, and is kept as it is when it matches
+ *  nothing, so the error shows up when it is opened.
+ *
+ *  \param input name given on the command line.
+ *  \param file_names array with the file names, grown as needed.
+ *  \param num_files number of files.
+ *  \param max_files number of names that fit in the array.
+ */
+
+void expand_input(const char *input, char ***file_names, int *num_files, int *max_files) {
+
+  struct stat st;
+  glob_t matches;
+
+  if (strcmp(input, "-") != 0 && stat(input, &st) == 0 && S_ISDIR(st.st_mode)) {
+    add_directory(input, file_names, num_files, max_files);
+    return;
+  }
+
+  if (strcmp(input, "-") == 0 || stat(input, &st) == 0 || strpbrk(input, "*?[") == NULL ||
+      glob(input, 0, NULL, &matches) != 0) {
+    add_name(input, file_names, num_files, max_files);
+    return;
+  }
+
+  for (size_t i = 0; i < matches.gl_pathc; i++) {
+    if (stat(matches.gl_pathv[i], &st) == 0 && S_ISDIR(st.st_mode))
+      add_directory(matches.gl_pathv[i], file_names, num_files, max_files);
+    else
+      add_name(matches.gl_pathv[i], file_names, num_files, max_files);
+  }
+
+  globfree(&matches);
+}
+
+/** \brief sizes of the files, to order them from the largest */
+static const long long *sort_sizes;
+
+/**
+ *  \brief Order file indexes by decreasing size, then by index.
+ */
+
+static int compare_files(const void *a, const void *b) {
+
+  int left = *(const int *)a, right = *(const int *)b;
+
+  if (sort_sizes[left] != sort_sizes[right])
+    return sort_sizes[left] > sort_sizes[right] ? -1 : 1;
+
+  return left - right;
+}
+
+/**
+ *  \brief Order pieces by decreasing size, then by file.
+ */
+
+static int compare_pieces(const void *a, const void *b) {
+
+  const Piece *left = (const Piece *)a, *right = (const Piece *)b;
+
+  if (left->n_bytes != right->n_bytes)
+    return left->n_bytes > right->n_bytes ? -1 : 1;
+
+  return left->file_index - right->file_index;
+}
+
+/**
+ *  \brief Plan the work items from the sizes of the files.
+ *
+ *  The remainders are packed taking the largest one left and filling the item with the next
+ *  largest ones that fit, then with the smallest ones, up to PLAN_MAX_PIECES pieces.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks and of the work items.
+ *  \param plan work items and their pieces.
+ */
+
+static void make_plan(char *file_names[], int num_files, int chunk_bytes, Plan *plan) {
+
+  struct stat st;
+  long long *sizes = malloc(num_files * sizeof(long long));
+  int *order = malloc(num_files * sizeof(int));
+  long long n_pieces = 0;
+  int n_rest = 0;
+
+  for (int i = 0; i < num_files; i++) {
+    order[i] = i;
+    sizes[i] = 0;
+
+    if (stat(file_names[i], &st) != 0)
+      fprintf(stderr, "Could not open file %s: %s\n", file_names[i], strerror(errno));
+    else if (!S_ISREG(st.st_mode))
+      fprintf(stderr, "File %s is not a regular file\n", file_names[i]);
+    else
+      sizes[i] = st.st_size;
+
+    n_pieces += (sizes[i] + chunk_bytes - 1) / chunk_bytes;
+  }
+
+  /* largest files first */
+  sort_sizes = sizes;
+  qsort(order, num_files, sizeof(int), compare_files);
+
+  plan->pieces = malloc((n_pieces + 1) * sizeof(Piece));
+  plan->items = malloc((n_pieces + 1) * sizeof(WorkItem));
+  plan->n_pieces = 0;
+  plan->n_items = 0;
+
+  Piece *rest = malloc((num_files + 1) * sizeof(Piece));
+
+  /* every full chunk is an item */
+  for (int k = 0; k < num_files; k++) {
+    int i = order[k];
+    long long n_full = sizes[i] / chunk_bytes;
+
+    for (long long c = 0; c < n_full; c++) {
+      plan->items[plan->n_items].first = plan->n_pieces;
+      plan->items[plan->n_items++].n_pieces = 1;
+      plan->pieces[plan->n_pieces++] = (Piece){ i, (int)c, c * chunk_bytes, chunk_bytes };
+    }
+
+    if (sizes[i] % chunk_bytes != 0)
+      rest[n_rest++] = (Piece){ i, (int)n_full, n_full * chunk_bytes, (int)(sizes[i] % chunk_bytes) };
+  }
+
+  /* the remainders are packed, from the largest to the smallest */
+  qsort(rest, n_rest, sizeof(Piece), compare_pieces);
+
+  for (int front = 0, back = n_rest - 1; front <= back; ) {
+    WorkItem *item = &plan->items[plan->n_items++];
+    int n_bytes = 0;
+
+    item->first = plan->n_pieces;
+    item->n_pieces = 0;
+
+    while (front <= back && item->n_pieces < PLAN_MAX_PIECES &&
+           (item->n_pieces == 0 || n_bytes + rest[front].n_bytes <= chunk_bytes)) {
+      n_bytes += rest[front].n_bytes;
+      plan->pieces[plan->n_pieces++] = rest[front++];
+      item->n_pieces++;
+    }
+
+    while (front <= back && item->n_pieces < PLAN_MAX_PIECES && n_bytes + rest[back].n_bytes <= chunk_bytes) {
+      n_bytes += rest[back].n_bytes;
+      plan->pieces[plan->n_pieces++] = rest[back--];
+      item->n_pieces++;
+    }
+  }
+
+  free(sizes);
+  free(order);
+  free(rest);
+}
+
+/**
+ *  \brief Read a piece of a file, keeping the last file open for the pieces after it.
+ *
+ *  \param file_names array with the file names.
+ *  \param piece piece to be read.
+ *  \param bytes buffer for the bytes of the piece.
+ *  \param fd descriptor of the last file opened, -1 if none.
+ *  \param fd_file index of the last file opened.
+ *  \return number of bytes read.
+ */
+
+static int read_piece(char *file_names[], const Piece *piece, unsigned char *bytes, int *fd, int *fd_file) {
+
+  int total = 0;
+  ssize_t n;
+
+  if (*fd_file != piece->file_index) {
+    if (*fd != -1)
+      close(*fd);
+    *fd = open(file_names[piece->file_index], O_RDONLY);
+    *fd_file = piece->file_index;
+  }
+
+  while (*fd != -1 && total < piece->n_bytes) {
+    n = pread(*fd, bytes + total, piece->n_bytes - total, piece->offset + total);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+
+    total += n;
+  }
+
+  if (total < piece->n_bytes)
+    fprintf(stderr, "Could not read file %s\n", file_names[piece->file_index]);
+
+  return total;
+}
+
+/**
+ *  \brief Build the message of a work item: its header, the headers of its pieces and their bytes.
+ *
+ *  \return size of the message.
+ */
+
+static int pack_item(char *file_names[], const Plan *plan, const WorkItem *item, unsigned char *buffer, int *fd,
+                     int *fd_file) {
+
+  ItemHeader *header = (ItemHeader *)buffer;
+  ChunkHeader *pieces = (ChunkHeader *)(buffer + sizeof(ItemHeader));
+  unsigned char *bytes = buffer + sizeof(ItemHeader) + item->n_pieces * sizeof(ChunkHeader);
+
+  header->n_pieces = item->n_pieces;
+
+  for (int i = 0; i < item->n_pieces; i++) {
+    const Piece *piece = &plan->pieces[item->first + i];
+
+    pieces[i].file_index = piece->file_index;
+    pieces[i].chunk_index = piece->chunk_index;
+    pieces[i].n_bytes = read_piece(file_names, piece, bytes, fd, fd_file);
+    bytes += pieces[i].n_bytes;
+  }
+
+  return bytes - buffer;
+}
+
+/**
+ *  \brief planned dispatcher.
+ *
+ *  Plans the work items, hands them out on demand with MAX_IN_FLIGHT items queued per worker, and
+ *  merges the result of every piece into its file.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks and of the work items.
+ */
+
+void planned_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int n_workers, n_slots;
+  int next_item = 0, in_flight = 0;
+  int fd = -1, fd_file = -1;
+  int count;
+  Plan plan;
+  MPI_Status status;
+  ItemHeader end = { -1 };
+
+  MPI_Comm_size(MPI_COMM_WORLD, &n_workers);
+  n_workers -= 1;
+  n_slots = n_workers * MAX_IN_FLIGHT;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  make_plan(file_names, num_files, chunk_bytes, &plan);
+
+  /* the number of chunks of every file is known from the start */
+  int *n_chunks = calloc(num_files, sizeof(int));
+
+  for (int i = 0; i < plan.n_pieces; i++)
+    n_chunks[plan.pieces[i].file_index]++;
+
+  for (unsigned int i = 0; i < num_files; i++)
+    set_file_chunks(i, n_chunks[i]);
+
+  free(n_chunks);
+
+  /* the items of every worker are sent from a ring of buffers */
+  size_t item_bytes = sizeof(ItemHeader) + PLAN_MAX_PIECES * sizeof(ChunkHeader) + chunk_bytes;
+  unsigned char **slots = malloc(n_slots * sizeof(unsigned char *));
+  MPI_Request *requests = malloc(n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_workers, sizeof(int));
+  ChunkResult *results = malloc(PLAN_MAX_PIECES * sizeof(ChunkResult));
+
+  for (int i = 0; i < n_slots; i++) {
+    slots[i] = malloc(item_bytes);
+    requests[i] = MPI_REQUEST_NULL;
+  }
+
+  /* fill the queue of every worker, then give a new item to each worker that returns a result */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++)
+    for (int worker_id = 1; worker_id <= n_workers && next_item < plan.n_items; worker_id++) {
+      int slot = (worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1];
+      int size = pack_item(file_names, &plan, &plan.items[next_item++], slots[slot], &fd, &fd_file);
+
+      MPI_Isend(slots[slot], size, MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &requests[slot]);
+      next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+      in_flight++;
+    }
+
+  while (in_flight > 0) {
+
+    MPI_Recv(results, PLAN_MAX_PIECES * sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    MPI_Get_count(&status, MPI_BYTE, &count);
+    in_flight--;
+
+    for (int i = 0; i < count / (int)sizeof(ChunkResult); i++)
+      save_file_results(&results[i]);
+
+    if (next_item < plan.n_items) {
+      int worker_id = status.MPI_SOURCE;
+      int slot = (worker_id - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1];
+
+      /* the worker returned the result of the oldest item in its ring */
+      MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+
+      int size = pack_item(file_names, &plan, &plan.items[next_item++], slots[slot], &fd, &fd_file);
+
+      MPI_Isend(slots[slot], size, MPI_BYTE, worker_id, 0, MPI_COMM_WORLD, &requests[slot]);
+      next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+      in_flight++;
+    }
+  }
+
+  MPI_Waitall(n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal workers that there is no more work to be done */
+  for (int worker_id = 1; worker_id <= n_workers; worker_id++)
+    MPI_Send(&end, sizeof(ItemHeader), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  if (fd != -1)
+    close(fd);
+
+  for (int i = 0; i < n_slots; i++)
+    free(slots[i]);
+
+  free(slots);
+  free(requests);
+  free(next_slot);
+  free(results);
+  free(plan.pieces);
+  free(plan.items);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief planned worker.
+ *
+ *  Receives work items of any size, processes each of their pieces and sends back one result per
+ *  piece.
+ *
+ *  \param rank worker id.
+ */
+
+void planned_worker(int rank) {
+
+  MPI_Status status;
+  unsigned char *buffer = NULL;
+  int capacity = 0, size;
+  ChunkResult *results = malloc(PLAN_MAX_PIECES * sizeof(ChunkResult));
+
+  while (true) {
+
+    /* the size of the item is only known once it arrives */
+    MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+    MPI_Get_count(&status, MPI_BYTE, &size);
+
+    if (size > capacity) {
+      capacity = size;
+      buffer = realloc(buffer, capacity);
+    }
+
+    MPI_Recv(buffer, size, MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    ItemHeader *header = (ItemHeader *)buffer;
+
+    /* if no more work */
+    if (header->n_pieces < 0)
+      break;
+
+    const ChunkHeader *pieces = (const ChunkHeader *)(buffer + sizeof(ItemHeader));
+    const unsigned char *bytes = buffer + sizeof(ItemHeader) + header->n_pieces * sizeof(ChunkHeader);
+
+    for (int i = 0; i < header->n_pieces; i++) {
+      processChunk(bytes, pieces[i].n_bytes, &results[i]);
+      results[i].file_index = pieces[i].file_index;
+      results[i].chunk_index = pieces[i].chunk_index;
+      bytes += pieces[i].n_bytes;
+    }
+
+    MPI_Send(results, header->n_pieces * sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+  }
+
+  free(buffer);
+  free(results);
+}
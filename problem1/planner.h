@@ -0,0 +1,27 @@
+/**
+ *  \file planner.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the input expansion and of the planned mode, where the work is
+ *  planned up front from the sizes of the files:
+ *     \li expand_input
+ *     \li planned_dispatcher
+ *     \li planned_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef PLANNER_H_
+#define PLANNER_H_
+
+/** \brief Add a file, the files under a directory or the files matched by a glob pattern to the file names */
+extern void expand_input(const char *input, char ***file_names, int *num_files, int *max_files);
+
+/** \brief Plan the work items, hand them out on demand and merge the results of every file */
+extern void planned_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Process the pieces of files of every work item received */
+extern void planned_worker(int rank);
+
+#endif /* PLANNER_H_ */
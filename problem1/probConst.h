@@ -13,7 +13,152 @@
 
 /* Generic parameters */
 
-/** \brief Number of bytes to read */
+/** \brief Default size of the chunks, in bytes, and size of the pieces decoded at a time by the workers */
 #define NUM_BYTES   2000
 
+/** \brief Size of the read() calls when a file cannot be memory mapped */
+#define READ_BLOCK   (1024 * 1024)
+
+/** \brief Number of chunks kept in flight per worker in the dynamic scheduling mode */
+#define MAX_IN_FLIGHT   2
+
+/** \brief Number of chunk buffers per worker in the pipelined mode */
+#define PIPELINE_DEPTH   3
+
+/** \brief Size of the blocks read at a time in the parallel reading mode */
+#define MPIIO_BLOCK   (4 * 1024 * 1024)
+
+/** \brief Minimum byte range given to each worker in the parallel reading mode */
+#define MPIIO_MIN_RANGE   (64 * 1024)
+
+/** \brief Size of the chunks shared by the threads of a worker in the hybrid mode */
+#define HYBRID_BYTES   (1024 * 1024)
+
+/** \brief Largest chunk of a worker in the adaptive mode */
+#define ADAPT_MAX_BYTES   (4 * 1024 * 1024)
+
+/** \brief Share of the compute time above which the time lost around a chunk makes the next ones grow */
+#define ADAPT_OVERHEAD   0.1
+
+/** \brief Seconds of computation above which the next chunks of a worker shrink */
+#define ADAPT_MAX_TIME   0.05
+
+/** \brief Near the end of the input, chunks are cut to the bytes left over this many times the workers */
+#define ADAPT_TAIL_SHARE   2
+
+/** \brief Default seconds between the rolling totals of the streaming mode */
+#define STREAM_INTERVAL   1.0
+
+/** \brief Milliseconds the streaming mode waits for input before checking the results again */
+#define STREAM_POLL_MS   100
+
+/** \brief Default size of the blocks of a block-compressed file, and of the blocks a plain file is read in by the block mode */
+#define BLOCK_BYTES   (1024 * 1024)
+
+/** \brief Default seconds between two writes of the progress journal */
+#define JOURNAL_INTERVAL   60.0
+
+/** \brief Default number of most frequent words printed for every file in the word frequency mode */
+#define FREQ_TOP_K   10
+
+/** \brief Longest word, in bytes, kept by the word frequency mode; longer words are cut */
+#define FREQ_MAX_WORD   64
+
+/** \brief Default size of the work items of the planned mode, small files are packed together up to it */
+#define PLAN_BYTES   (64 * 1024)
+
+/** \brief Most pieces of files packed in one work item of the planned mode */
+#define PLAN_MAX_PIECES   256
+
+/** \brief Default size of the ranges handed to the sub-dispatcher of every node in the tree mode */
+#define TREE_BYTES   (1024 * 1024)
+
+/** \brief Default bytes of every round of the static mode for each worker */
+#define STATIC_BYTES   (256 * 1024)
+
+/** \brief Default size of the chunks counted in place by the pool of threads of the standalone mode */
+#define STANDALONE_BYTES   (64 * 1024)
+
+/** \brief Environment variable that forces (1) or rules out (0) the start of MPI, for undetected launchers */
+#define MPI_LAUNCH_ENV   "WORDS_MPI"
+
+/* When the results of each file are printed */
+
+/** \brief All the files at the end, in argument order */
+#define EMIT_END          0
+
+/** \brief Every file as soon as its last chunk is merged */
+#define EMIT_COMPLETION   1
+
+/** \brief Every file as soon as its last chunk and the last chunks of the files before it are merged */
+#define EMIT_ORDER        2
+
+/* Optional metrics, selected at compile time with -DMETRICS=<sum of the flags> (none by default) */
+
+/** \brief Histogram of the word lengths, and their average */
+#define METRIC_LENGTHS   1
+
+/** \brief Number of vowels, consonants, split chars, apostrophes and other chars */
+#define METRIC_CLASSES   2
+
+/** \brief Number of lines */
+#define METRIC_LINES     4
+
+#ifndef METRICS
+#define METRICS   0
+#endif
+
+/** \brief Longest word length with its own bin in the histogram, longer words sharing the last bin */
+#define METRIC_MAX_LENGTH   20
+
+/** \brief Number of char classes counted by METRIC_CLASSES */
+#define METRIC_N_CLASSES   5
+
+/* Scheduling modes */
+
+/** \brief Lock-step rounds: one chunk per worker, results collected in rank order */
+#define MODE_LOCKSTEP   0
+
+/** \brief Demand-driven: any worker that returns a result gets its next chunk right away */
+#define MODE_DYNAMIC    1
+
+/** \brief Parallel reading: each worker reads its own byte ranges of the files with MPI-IO */
+#define MODE_MPIIO      2
+
+/** \brief Pipelined: rings of buffers per worker with persistent requests, reading overlapped with computation */
+#define MODE_PIPELINE   3
+
+/** \brief Hybrid: large chunks on demand, split across a team of threads in every worker rank */
+#define MODE_HYBRID     4
+
+/** \brief Adaptive: demand-driven, with a chunk size per worker that follows its round trip and compute time */
+#define MODE_ADAPTIVE   5
+
+/** \brief Streaming: unbounded input from the standard input or a FIFO, with rolling totals */
+#define MODE_STREAM     6
+
+/** \brief Local accumulation: round-robin chunks, counters kept by the workers and reduced once at the end */
+#define MODE_LOCAL      7
+
+/** \brief Word frequency: round-robin chunks, per-word counts exchanged by hash and the most frequent words printed */
+#define MODE_FREQ       8
+
+/** \brief Blocks: the workers read and decompress blocks of block-compressed or plain files, handed out on demand */
+#define MODE_BLOCKS     9
+
+/** \brief Shared memory: on demand, the workers on the node of the dispatcher read the chunks in place from a shared window */
+#define MODE_SHM        10
+
+/** \brief Planned: work items planned from the file sizes, small files packed together, largest items first */
+#define MODE_PLANNED    11
+
+/** \brief Tree: large ranges on demand to one sub-dispatcher per node, split among the workers of the node */
+#define MODE_TREE       12
+
+/** \brief Static: rounds cut on word boundaries, handed out with MPI_Scatterv, counters summed with MPI_Reduce */
+#define MODE_STATIC     13
+
+/** \brief Standalone: a single process, without MPI, counts the chunks in place with a pool of threads */
+#define MODE_STANDALONE 14
+
 #endif /* PROBCONST_H_ */
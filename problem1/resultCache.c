@@ -0,0 +1,300 @@
+/**
+ *  \file resultCache.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Result cache. It keeps the final counters of every file counted, with the device, inode, size
+ *  and modification time of the file and a hash of its contents. A file whose device, inode, size
+ *  and modification time match an entry is not read at all. When they do not match but an entry
+ *  has the same size, the file is hashed and its counters are taken from an entry with the same
+ *  hash, so a copied or touched file is not counted again either.
+ *
+ *  The cache is a text file with one line per file, written to a temporary file renamed over the
+ *  old one. The hash is a 64 bit FNV-1a, that can be computed chunk by chunk as the file is read.
+ *
+ *  Definition of the operations:
+ *     \li cache_hash_update
+ *     \li cache_load
+ *     \li cache_lookup
+ *     \li cache_store
+ *     \li cache_save.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "probConst.h"
+#include "resultCache.h"
+
+/** \brief counters of a file and what identifies its contents */
+typedef struct {
+  char *name;
+  long long device;
+  long long inode;
+  long long size;
+  long long mtime_sec;
+  long long mtime_nsec;
+  uint64_t hash;
+  long long counters[3];
+} CacheEntry;
+
+/** \brief name of the cache file, NULL if no cache is kept */
+static const char *cache_name = NULL;
+
+/** \brief entries of the cache */
+static CacheEntry *entries = NULL;
+
+/** \brief number of entries */
+static int n_entries = 0;
+
+/** \brief number of entries that fit in the array */
+static int max_entries = 0;
+
+/**
+ *  \brief Add bytes to the hash of the contents of a file.
+ *
+ *  \param hash hash of the bytes before them, CACHE_HASH_INIT at the start of the file.
+ *  \param bytes bytes to be added.
+ *  \param n_bytes number of bytes.
+ *  \return hash with the bytes added.
+ */
+
+uint64_t cache_hash_update(uint64_t hash, const unsigned char *bytes, size_t n_bytes) {
+
+  for (size_t i = 0; i < n_bytes; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/**
+ *  \brief Hash the contents of a file.
+ *
+ *  \return 1 on success, 0 otherwise.
+ */
+
+static int hash_file(const char *file_name, uint64_t *hash) {
+
+  unsigned char *buffer = malloc(READ_BLOCK);
+  ssize_t n;
+  int fd = open(file_name, O_RDONLY);
+
+  if (fd == -1) {
+    free(buffer);
+    return 0;
+  }
+
+  *hash = CACHE_HASH_INIT;
+
+  while ((n = read(fd, buffer, READ_BLOCK)) != 0) {
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n == -1)
+      break;
+    *hash = cache_hash_update(*hash, buffer, n);
+  }
+
+  close(fd);
+  free(buffer);
+
+  return n == 0;
+}
+
+/**
+ *  \brief Fill the device, inode, size and modification time of an entry from the file.
+ *
+ *  \return 1 for a regular file, 0 otherwise.
+ */
+
+static int stat_entry(const char *file_name, CacheEntry *entry) {
+
+  struct stat st;
+
+  if (stat(file_name, &st) != 0 || !S_ISREG(st.st_mode))
+    return 0;
+
+  entry->device = st.st_dev;
+  entry->inode = st.st_ino;
+  entry->size = st.st_size;
+  entry->mtime_sec = st.st_mtime;
+#ifdef __APPLE__
+  entry->mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+  entry->mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+
+  return 1;
+}
+
+/**
+ *  \brief Load the cache from a file, which may not exist yet.
+ *
+ *  \param name name of the cache file, kept to save the cache at the end.
+ */
+
+void cache_load(const char *name) {
+
+  char line[4096 + 256];
+  FILE *cache;
+  CacheEntry entry;
+  unsigned long long hash;
+  int name_at;
+
+  cache_name = name;
+
+  if ((cache = fopen(cache_name, "r")) == NULL)
+    return;
+
+  while (fgets(line, sizeof(line), cache) != NULL) {
+
+    if (line[0] == '#')
+      continue;
+
+    line[strcspn(line, "\n")] = '\0';
+
+    if (sscanf(line, "%lld %lld %lld %lld %lld %llx %lld %lld %lld %n", &entry.device, &entry.inode, &entry.size,
+               &entry.mtime_sec, &entry.mtime_nsec, &hash, &entry.counters[0], &entry.counters[1],
+               &entry.counters[2], &name_at) < 9)
+      continue;
+
+    if (n_entries == max_entries) {
+      max_entries = max_entries ? 2 * max_entries : 1024;
+      entries = realloc(entries, max_entries * sizeof(CacheEntry));
+    }
+
+    entry.hash = hash;
+    entry.name = strdup(line + name_at);
+    entries[n_entries++] = entry;
+  }
+
+  fclose(cache);
+}
+
+/**
+ *  \brief Find the counters of a file that did not change since they were cached.
+ *
+ *  \param file_name name of the file.
+ *  \param counters number of words, of words beginning with a vowel and of words ending with a
+ *  consonant.
+ *  \param hash hash of the contents of the file.
+ *  \return 1 if the file was found, 0 otherwise.
+ */
+
+int cache_lookup(const char *file_name, long long counters[3], uint64_t *hash) {
+
+  CacheEntry file;
+  int same_size = 0;
+
+  if (cache_name == NULL || !stat_entry(file_name, &file))
+    return 0;
+
+  /* the same file, not modified since */
+  for (int i = 0; i < n_entries; i++) {
+    if (entries[i].size != file.size)
+      continue;
+
+    same_size = 1;
+
+    if (entries[i].device == file.device && entries[i].inode == file.inode &&
+        entries[i].mtime_sec == file.mtime_sec && entries[i].mtime_nsec == file.mtime_nsec) {
+      memcpy(counters, entries[i].counters, sizeof(entries[i].counters));
+      *hash = entries[i].hash;
+      return 1;
+    }
+  }
+
+  /* the same contents, only worth hashing if a file had the same size */
+  if (!same_size || !hash_file(file_name, &file.hash))
+    return 0;
+
+  for (int i = 0; i < n_entries; i++) {
+    if (entries[i].size == file.size && entries[i].hash == file.hash) {
+      memcpy(counters, entries[i].counters, sizeof(entries[i].counters));
+      *hash = file.hash;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Keep the counters of a file, in place of the entry with the same name.
+ *
+ *  \param file_name name of the file.
+ *  \param hash hash of the contents of the file.
+ *  \param counters number of words, of words beginning with a vowel and of words ending with a
+ *  consonant.
+ */
+
+void cache_store(const char *file_name, uint64_t hash, const long long counters[3]) {
+
+  CacheEntry entry;
+  int i;
+
+  if (cache_name == NULL || !stat_entry(file_name, &entry))
+    return;
+
+  entry.hash = hash;
+  memcpy(entry.counters, counters, sizeof(entry.counters));
+
+  for (i = 0; i < n_entries && strcmp(entries[i].name, file_name) != 0; i++)
+    ;
+
+  if (i == n_entries) {
+    if (n_entries == max_entries) {
+      max_entries = max_entries ? 2 * max_entries : 1024;
+      entries = realloc(entries, max_entries * sizeof(CacheEntry));
+    }
+    entry.name = strdup(file_name);
+    n_entries++;
+  }
+  else
+    entry.name = entries[i].name;
+
+  entries[i] = entry;
+}
+
+/**
+ *  \brief Save the cache to its file.
+ *
+ *  The cache is written to a temporary file renamed over the old one, so a crash leaves either of
+ *  them whole.
+ */
+
+void cache_save() {
+
+  char tmp_name[4096];
+  FILE *cache;
+
+  if (cache_name == NULL)
+    return;
+
+  snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", cache_name);
+
+  if ((cache = fopen(tmp_name, "w")) == NULL) {
+    fprintf(stderr, "Could not write cache %s: %s\n", tmp_name, strerror(errno));
+    return;
+  }
+
+  fprintf(cache, "# device inode size mtime mtime_nsec hash words vowels cons name\n");
+
+  for (int i = 0; i < n_entries; i++)
+    fprintf(cache, "%lld %lld %lld %lld %lld %016llx %lld %lld %lld %s\n", entries[i].device, entries[i].inode,
+            entries[i].size, entries[i].mtime_sec, entries[i].mtime_nsec, (unsigned long long)entries[i].hash,
+            entries[i].counters[0], entries[i].counters[1], entries[i].counters[2], entries[i].name);
+
+  if (fflush(cache) != 0 || fsync(fileno(cache)) != 0 || fclose(cache) != 0 || rename(tmp_name, cache_name) != 0)
+    fprintf(stderr, "Could not write cache %s: %s\n", cache_name, strerror(errno));
+}
@@ -0,0 +1,41 @@
+/**
+ *  \file resultCache.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations on the result cache, that keeps the counters of the files counted
+ *  before, so the files that did not change are not counted again:
+ *     \li cache_hash_update
+ *     \li cache_load
+ *     \li cache_lookup
+ *     \li cache_store
+ *     \li cache_save.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef RESULTCACHE_H_
+#define RESULTCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** \brief Initial value of the hash of the contents of a file */
+#define CACHE_HASH_INIT   14695981039346656037ULL
+
+/** \brief Add bytes to the hash of the contents of a file */
+extern uint64_t cache_hash_update(uint64_t hash, const unsigned char *bytes, size_t n_bytes);
+
+/** \brief Load the cache from a file */
+extern void cache_load(const char *cache_name);
+
+/** \brief Find the counters of a file that did not change since they were cached */
+extern int cache_lookup(const char *file_name, long long counters[3], uint64_t *hash);
+
+/** \brief Keep the counters of a file */
+extern void cache_store(const char *file_name, uint64_t hash, const long long counters[3]);
+
+/** \brief Save the cache to its file */
+extern void cache_save();
+
+#endif /* RESULTCACHE_H_ */
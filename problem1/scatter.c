@@ -0,0 +1,294 @@
+/**
+ *  \file scatter.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Static mode, for uniform inputs that need no load balancing. Every round the dispatcher reads a
+ *  large buffer of a file, STATIC_BYTES per worker, cuts it into one slice per worker on word
+ *  boundaries and hands the slices out with a single MPI_Scatterv. As no word crosses a slice, each
+ *  worker counts its slices as whole texts into per-file counters, and the counters are summed with
+ *  a single MPI_Reduce at the end. All the data moves through collectives, so the MPI library can
+ *  use its own algorithms for them.
+ *
+ *  A slice is only cut after an ASCII split char and before a char that is not an apostrophe, so
+ *  the words at its start are counted as at the start of a file. The bytes after the last cut of a
+ *  buffer are kept for the next round.
+ *
+ *  Definition of the operations:
+ *     \li static_dispatcher
+ *     \li static_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "partialResult.h"
+#include "scatter.h"
+
+/** \brief slice of a round sent to a worker */
+typedef struct {
+  int file_index;
+  int n_bytes;                    /* -1 tells the worker to stop */
+} SliceHeader;
+
+/**
+ *  \brief Check if a buffer can be cut before a position, with no word across the cut.
+ *
+ *  The byte before must be an ASCII split char, which is never part of a multibyte char, and the
+ *  char after must not be an apostrophe (bytes starting with 0xE2 may be a typographic quote).
+ *
+ *  \param bytes bytes of the buffer.
+ *  \param pos position of the cut, greater than 0.
+ *  \return true if the buffer can be cut there, false otherwise.
+ */
+
+static bool is_cut(const unsigned char *bytes, int pos) {
+  return bytes[pos - 1] < 128 && is_split(bytes[pos - 1]) && bytes[pos] != '\'' && bytes[pos] != 0xE2;
+}
+
+/**
+ *  \brief Find the cut nearest before a target, or else after it, between two limits.
+ *
+ *  \return position of the cut, the upper limit if there is none.
+ */
+
+static int find_cut(const unsigned char *bytes, int low, int target, int high) {
+
+  for (int pos = target; pos > low; pos--)
+    if (is_cut(bytes, pos))
+      return pos;
+
+  for (int pos = target + 1; pos < high; pos++)
+    if (is_cut(bytes, pos))
+      return pos;
+
+  return high;
+}
+
+/**
+ *  \brief Fill the rest of a buffer from a file.
+ *
+ *  \return number of bytes read, 0 at the end of the file.
+ */
+
+static int fill_buffer(int fd, unsigned char *bytes, int n_bytes) {
+
+  int total = 0;
+  ssize_t n;
+
+  while (total < n_bytes) {
+    n = read(fd, bytes + total, n_bytes - total);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+
+    total += n;
+  }
+
+  return total;
+}
+
+/**
+ *  \brief Hand out a round: the headers of the slices with MPI_Scatter, then their bytes with
+ *  MPI_Scatterv. The dispatcher gets no slice.
+ *
+ *  \param bytes bytes of the round.
+ *  \param headers header of the slice of every process, the first one being the dispatcher's.
+ *  \param counts number of bytes sent to every process.
+ *  \param displs offset of the slice of every process.
+ */
+
+static void scatter_round(const unsigned char *bytes, SliceHeader *headers, int *counts, int *displs) {
+
+  SliceHeader own;
+
+  MPI_Scatter(headers, sizeof(SliceHeader), MPI_BYTE, &own, sizeof(SliceHeader), MPI_BYTE, 0, MPI_COMM_WORLD);
+  MPI_Scatterv(bytes, counts, displs, MPI_BYTE, NULL, 0, MPI_BYTE, 0, MPI_COMM_WORLD);
+}
+
+/**
+ *  \brief static dispatcher.
+ *
+ *  Reads every file in rounds of STATIC_BYTES (or -n bytes) per worker, cut on word boundaries,
+ *  scatters them to the workers and gets the counters of every file with one reduction.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes bytes of a round for each worker.
+ */
+
+void static_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int size, n_workers;
+  int files = num_files;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  n_workers = size - 1;
+
+  /* the workers need the number of files for their counters */
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  SliceHeader *headers = calloc(size, sizeof(SliceHeader));
+  int *counts = calloc(size, sizeof(int));
+  int *displs = calloc(size, sizeof(int));
+  int capacity = n_workers * chunk_bytes;
+  unsigned char *bytes = malloc(capacity);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  for (int file = 0; file < files; file++) {
+
+    int fd = open(file_names[file], O_RDONLY);
+    int n_bytes = 0, n_read;
+    bool at_end = false;
+
+    if (fd == -1) {
+      fprintf(stderr, "Could not open file %s: %s\n", file_names[file], strerror(errno));
+      continue;
+    }
+
+    while (!at_end) {
+
+      n_read = fill_buffer(fd, bytes + n_bytes, capacity - n_bytes);
+      n_bytes += n_read;
+      at_end = n_bytes < capacity;
+
+      /* the round ends at the last cut, or at the end of the file */
+      int round_bytes = at_end ? n_bytes : find_cut(bytes, 0, n_bytes - 1, 0);
+
+      if (round_bytes == 0 && at_end)
+        break;
+
+      /* a single word fills the buffer, which grows until the word ends */
+      if (round_bytes == 0) {
+        capacity *= 2;
+        bytes = realloc(bytes, capacity);
+        continue;
+      }
+
+      /* one slice per worker, of about the same size */
+      int begin = 0;
+      for (int i = 1; i <= n_workers; i++) {
+        int target = (int)((long long)round_bytes * i / n_workers);
+        int end = i == n_workers ? round_bytes : find_cut(bytes, begin, target, round_bytes);
+
+        headers[i].file_index = file;
+        headers[i].n_bytes = end - begin;
+        counts[i] = end - begin;
+        displs[i] = begin;
+        begin = end;
+      }
+
+      scatter_round(bytes, headers, counts, displs);
+
+      /* the bytes after the cut start the next round */
+      memmove(bytes, bytes + round_bytes, n_bytes - round_bytes);
+      n_bytes -= round_bytes;
+    }
+
+    close(fd);
+  }
+
+  /* signal workers that there is no more work to be done */
+  for (int i = 1; i <= n_workers; i++) {
+    headers[i].n_bytes = -1;
+    counts[i] = 0;
+  }
+  scatter_round(bytes, headers, counts, displs);
+
+  /* sum the counters of the workers, the root adding none */
+  long long *counters = calloc(3 * files, sizeof(long long));
+  MPI_Reduce(MPI_IN_PLACE, counters, 3 * files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  for (int i = 0; i < files; i++)
+    add_file_counters(i, counters[3 * i], counters[3 * i + 1], counters[3 * i + 2]);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  free(headers);
+  free(counts);
+  free(displs);
+  free(bytes);
+  free(counters);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief static worker.
+ *
+ *  Counts the slice it gets every round as a whole text, adds its counters to those of its file
+ *  and takes part in the final reduction.
+ *
+ *  \param rank worker id.
+ *  \param chunk_bytes bytes of a round for each worker.
+ */
+
+void static_worker(int rank, int chunk_bytes) {
+
+  int files, capacity = chunk_bytes;
+  long long num_words, num_vowels, num_cons;
+  SliceHeader header;
+  ChunkResult result;
+
+  MPI_Bcast(&files, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  long long *counters = calloc(3 * files, sizeof(long long));
+  unsigned char *slice = malloc(capacity);
+
+  while (true) {
+
+    MPI_Scatter(NULL, 0, MPI_BYTE, &header, sizeof(SliceHeader), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    /* a slice may be larger than a chunk if a word did not fit */
+    if (header.n_bytes > capacity) {
+      capacity = header.n_bytes;
+      slice = realloc(slice, capacity);
+    }
+
+    MPI_Scatterv(NULL, NULL, NULL, MPI_BYTE, slice, header.n_bytes > 0 ? header.n_bytes : 0, MPI_BYTE, 0,
+                 MPI_COMM_WORLD);
+
+    /* if no more work */
+    if (header.n_bytes < 0)
+      break;
+
+    if (header.n_bytes == 0)
+      continue;
+
+    /* no word crosses the slice, so it is counted as a whole text */
+    processChunk(slice, header.n_bytes, &result);
+    result_finish(&result, &num_words, &num_vowels, &num_cons);
+
+    counters[3 * header.file_index] += num_words;
+    counters[3 * header.file_index + 1] += num_vowels;
+    counters[3 * header.file_index + 2] += num_cons;
+  }
+
+  MPI_Reduce(counters, NULL, 3 * files, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  free(counters);
+  free(slice);
+}
@@ -0,0 +1,23 @@
+/**
+ *  \file scatter.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the static mode, where the rounds are cut on word boundaries and
+ *  handed out with collectives:
+ *     \li static_dispatcher
+ *     \li static_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef SCATTER_H_
+#define SCATTER_H_
+
+/** \brief Scatter the files in rounds cut on word boundaries and reduce the counters of the workers */
+extern void static_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Count the slice of every round and take part in the final reduction */
+extern void static_worker(int rank, int chunk_bytes);
+
+#endif /* SCATTER_H_ */
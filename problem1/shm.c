@@ -0,0 +1,292 @@
+/**
+ *  \file shm.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Shared memory mode. The processes that share a node are found with MPI_Comm_split_type. The
+ *  dispatcher allocates a shared window with MAX_IN_FLIGHT slots for each worker of its node and
+ *  copies the chunks straight into them, so these workers only receive the offset and size of a
+ *  chunk and read its bytes in place. The workers on other nodes get the chunks in messages, as in
+ *  the dynamic mode. Chunks are handed out on demand, and the result of a chunk frees its slot, as
+ *  each worker processes its chunks in order.
+ *
+ *  The window is accessed inside a passive target epoch, with MPI_Win_sync after the dispatcher
+ *  writes a slot and before a worker reads it.
+ *
+ *  Definition of the operations:
+ *     \li shm_dispatcher
+ *     \li shm_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "shm.h"
+
+/** \brief chunk placed in the shared window: its header and its offset in the window */
+typedef struct {
+  ChunkHeader header;
+  long long offset;
+} ShmChunk;
+
+/** \brief processes of the node of a rank and the shared window of the dispatcher */
+typedef struct {
+  MPI_Comm comm;                  /* processes of the node */
+  int *world_ranks;               /* rank in MPI_COMM_WORLD of every process of the node */
+  int size;
+  bool with_root;                 /* true on the node of the dispatcher */
+  MPI_Win win;
+  unsigned char *base;            /* start of the window of the dispatcher */
+} NodeWindow;
+
+/**
+ *  \brief Find the processes of the node and, on the node of the dispatcher, allocate its window.
+ *
+ *  Collective operation of all the processes.
+ *
+ *  \param node processes of the node and shared window.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+static void open_node_window(NodeWindow *node, int chunk_bytes) {
+
+  int rank, node_rank, disp_unit;
+  MPI_Aint size;
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  /* ordered by world rank, so the dispatcher is the first process of its node */
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node->comm);
+  MPI_Comm_size(node->comm, &node->size);
+  MPI_Comm_rank(node->comm, &node_rank);
+
+  node->world_ranks = malloc(node->size * sizeof(int));
+  MPI_Allgather(&rank, 1, MPI_INT, node->world_ranks, 1, MPI_INT, node->comm);
+
+  node->with_root = node->world_ranks[0] == 0;
+  node->base = NULL;
+
+  if (!node->with_root)
+    return;
+
+  /* MAX_IN_FLIGHT slots for every other process of the node */
+  size = node_rank == 0 ? (MPI_Aint)(node->size - 1) * MAX_IN_FLIGHT * chunk_bytes : 0;
+
+  MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, node->comm, &node->base, &node->win);
+  MPI_Win_shared_query(node->win, 0, &size, &disp_unit, &node->base);
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, node->win);
+}
+
+/**
+ *  \brief Free the window and the communicator of the node.
+ *
+ *  \param node processes of the node and shared window.
+ */
+
+static void close_node_window(NodeWindow *node) {
+
+  if (node->with_root) {
+    MPI_Win_unlock_all(node->win);
+    MPI_Win_free(&node->win);
+  }
+
+  MPI_Comm_free(&node->comm);
+  free(node->world_ranks);
+}
+
+/**
+ *  \brief Send the next chunk to a worker, through its next slot of the window when it shares the
+ *  node of the dispatcher.
+ *
+ *  \param worker_id worker id.
+ *  \param node processes of the node and shared window.
+ *  \param local index of the worker in the node, 0 if it is on another node.
+ *  \param next_slot next slot of each worker.
+ *  \param chunk buffer of the chunks sent in messages.
+ *  \param chunk_bytes size of the chunks.
+ *  \return true if there was still a chunk, false otherwise.
+ */
+
+static bool post_shared_chunk(int worker_id, NodeWindow *node, int local, int *next_slot, WireChunk *chunk,
+                              int chunk_bytes) {
+
+  ChunkView view;
+  ShmChunk shared;
+
+  if (local == 0) {
+    if (!getChunk(chunk, chunk_bytes))
+      return false;
+
+    MPI_Send(chunk, WIRE_SIZE(chunk), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+    return true;
+  }
+
+  if (!getChunkView(&view, chunk_bytes))
+    return false;
+
+  shared.header.file_index = view.file_index;
+  shared.header.chunk_index = view.chunk_index;
+  shared.header.n_bytes = view.n_bytes;
+  shared.offset = ((long long)(local - 1) * MAX_IN_FLIGHT + next_slot[worker_id - 1]) * chunk_bytes;
+
+  memcpy(node->base + shared.offset, view.bytes, view.n_bytes);
+
+  /* make the bytes visible to the worker before it gets the offset */
+  MPI_Win_sync(node->win);
+
+  MPI_Send(&shared, sizeof(ShmChunk), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+
+  next_slot[worker_id - 1] = (next_slot[worker_id - 1] + 1) % MAX_IN_FLIGHT;
+
+  return true;
+}
+
+/**
+ *  \brief shared memory dispatcher.
+ *
+ *  Hands out the chunks on demand, through the shared window to the workers of its node and in
+ *  messages to the others, and merges their results.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void shm_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int n_workers, in_flight = 0;
+  NodeWindow node;
+  ChunkResult result;
+  ChunkHeader end;
+  MPI_Status status;
+  bool data_left = true;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &n_workers);
+  n_workers -= 1;
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  open_node_window(&node, chunk_bytes);
+
+  /* index of every worker in the node of the dispatcher, 0 for the workers on other nodes */
+  int *local = calloc(n_workers + 1, sizeof(int));
+  int *next_slot = calloc(n_workers, sizeof(int));
+  WireChunk *chunk = malloc(WIRE_BYTES(chunk_bytes));
+
+  for (int i = 1; i < node.size; i++)
+    local[node.world_ranks[i]] = i;
+
+  /* fill the slots of every worker */
+  for (int i = 0; i < MAX_IN_FLIGHT && data_left; i++)
+    for (int worker_id = 1; worker_id <= n_workers && data_left; worker_id++) {
+      data_left = post_shared_chunk(worker_id, &node, local[worker_id], next_slot, chunk, chunk_bytes);
+      if (data_left)
+        in_flight++;
+    }
+
+  /* the result of a chunk frees its slot for the next one */
+  while (in_flight > 0) {
+
+    MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    in_flight--;
+
+    save_file_results(&result);
+
+    if (data_left) {
+      data_left = post_shared_chunk(status.MPI_SOURCE, &node, local[status.MPI_SOURCE], next_slot, chunk,
+                                    chunk_bytes);
+      if (data_left)
+        in_flight++;
+    }
+  }
+
+  /* signal workers that there is no more work to be done */
+  end.n_bytes = -1;
+  for (int worker_id = 1; worker_id <= n_workers; worker_id++)
+    MPI_Send(&end, sizeof(ChunkHeader), MPI_BYTE, worker_id, 0, MPI_COMM_WORLD);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  close_node_window(&node);
+
+  free(local);
+  free(next_slot);
+  free(chunk);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief shared memory worker.
+ *
+ *  Processes the chunks in the shared window of the dispatcher when it shares its node, or the
+ *  chunks received in messages otherwise, and sends their partial results back.
+ *
+ *  \param rank worker id.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void shm_worker(int rank, int chunk_bytes) {
+
+  NodeWindow node;
+  ShmChunk shared;
+  ChunkResult result;
+  WireChunk *chunk = NULL;
+
+  open_node_window(&node, chunk_bytes);
+
+  if (!node.with_root)
+    chunk = malloc(WIRE_BYTES(chunk_bytes));
+
+  while (true) {
+
+    if (node.with_root) {
+      MPI_Recv(&shared, sizeof(ShmChunk), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+      /* if no more work */
+      if (shared.header.n_bytes < 0)
+        break;
+
+      /* see the bytes written by the dispatcher before the offset was sent */
+      MPI_Win_sync(node.win);
+
+      processChunk(node.base + shared.offset, shared.header.n_bytes, &result);
+      result.file_index = shared.header.file_index;
+      result.chunk_index = shared.header.chunk_index;
+    }
+    else {
+      MPI_Recv(chunk, WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+      /* if no more work */
+      if (chunk->header.n_bytes < 0)
+        break;
+
+      processChunk(chunk->bytes, chunk->header.n_bytes, &result);
+      result.file_index = chunk->header.file_index;
+      result.chunk_index = chunk->header.chunk_index;
+    }
+
+    MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+  }
+
+  close_node_window(&node);
+
+  free(chunk);
+}
@@ -0,0 +1,23 @@
+/**
+ *  \file shm.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the shared memory mode, where the workers on the node of the
+ *  dispatcher read the chunks in place from a shared window:
+ *     \li shm_dispatcher
+ *     \li shm_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef SHM_H_
+#define SHM_H_
+
+/** \brief Hand out the chunks through a shared window on the node and in messages elsewhere */
+extern void shm_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Process the chunks read in place from the shared window, or received in messages */
+extern void shm_worker(int rank, int chunk_bytes);
+
+#endif /* SHM_H_ */
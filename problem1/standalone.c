@@ -0,0 +1,239 @@
+/**
+ *  \file standalone.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Standalone mode, used when the program runs as a single process, with or without mpiexec. No
+ *  MPI call is made: the main thread reads the chunks as the dispatcher does and puts views of them
+ *  in a bounded queue, and a pool of threads counts them as the workers do and merges their results.
+ *
+ *  The mapped files are kept until all their chunks are merged, so the queue only carries pointers
+ *  into them. Only the chunks of the files that cannot be mapped, as pipes or the standard input,
+ *  are copied out of the stream buffer. The queue has its own lock, which the reader only holds to
+ *  wait for room and to add a chunk, never while it reads, so a pipe that blocks does not stall the
+ *  pool. The results are merged under a second lock, which the reader only takes to close a file.
+ *
+ *  Definition of the operations:
+ *     \li standalone_dispatcher.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "standalone.h"
+
+/** \brief chunk waiting in the queue */
+typedef struct {
+  ChunkView view;
+  unsigned char *copy;            /* buffer the bytes were copied to, NULL if they are read in place */
+} QueuedChunk;
+
+/** \brief queue of chunks shared by the reader and the pool */
+typedef struct {
+  pthread_mutex_t lock;           /* guards the queue and the copy buffers */
+  pthread_mutex_t merge_lock;     /* guards the state of the dispatcher that the merges update */
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  QueuedChunk *items;
+  int capacity;
+  int head;
+  int count;
+  bool done;                      /* true once the last chunk was queued */
+  unsigned char **free_copies;    /* copy buffers no longer in use */
+  int n_free;
+  int chunk_bytes;
+} ChunkQueue;
+
+/**
+ *  \brief Take a free copy buffer, or allocate a new one.
+ *
+ *  At most one buffer is in use for each queued or processed chunk, so their number is bounded.
+ *  Called with the lock of the queue held.
+ *
+ *  \param queue queue of chunks.
+ *  \return buffer of chunk_bytes.
+ */
+
+static unsigned char *take_copy(ChunkQueue *queue) {
+
+  if (queue->n_free > 0)
+    return queue->free_copies[--queue->n_free];
+
+  return malloc(queue->chunk_bytes);
+}
+
+/**
+ *  \brief Thread of the pool: counts the chunks of the queue and merges their results.
+ *
+ *  \param arg queue of chunks.
+ */
+
+static void *pool_thread(void *arg) {
+
+  ChunkQueue *queue = arg;
+  QueuedChunk item;
+  ChunkResult result;
+
+  while (true) {
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->done)
+      pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+    /* if no more work */
+    if (queue->count == 0) {
+      pthread_mutex_unlock(&queue->lock);
+      break;
+    }
+
+    item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    /* process chunk */
+    processChunk(item.view.bytes, item.view.n_bytes, &result);
+
+    result.file_index = item.view.file_index;
+    result.chunk_index = item.view.chunk_index;
+
+    /* save results of the chunk, which may release the mapping of its file */
+    pthread_mutex_lock(&queue->merge_lock);
+    save_file_results(&result);
+    pthread_mutex_unlock(&queue->merge_lock);
+
+    if (item.copy != NULL) {
+      pthread_mutex_lock(&queue->lock);
+      queue->free_copies[queue->n_free++] = item.copy;
+      pthread_mutex_unlock(&queue->lock);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ *  \brief standalone dispatcher.
+ *
+ *  Reads the chunks on the main thread and queues them for a pool of threads, MAX_IN_FLIGHT chunks
+ *  per thread, then prints the final results once the pool is done.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param n_threads number of threads of the pool, 0 for one per online core.
+ *  \param chunk_bytes size of the chunks.
+ */
+
+void standalone_dispatcher(char *file_names[], unsigned int num_files, int n_threads, int chunk_bytes) {
+
+  struct timespec start, finish;
+  ChunkQueue queue;
+  ChunkView view;
+  pthread_t *threads;
+  unsigned char *copy;
+  int available;
+
+  if (n_threads <= 0)
+    n_threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+  /* the views of the mapped files must outlive the next reads */
+  pthread_mutex_init(&queue.merge_lock, NULL);
+  keep_file_maps(&queue.merge_lock);
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  queue.capacity = n_threads * MAX_IN_FLIGHT;
+  queue.items = malloc(queue.capacity * sizeof(QueuedChunk));
+  queue.head = 0;
+  queue.count = 0;
+  queue.done = false;
+  queue.free_copies = malloc((queue.capacity + n_threads) * sizeof(unsigned char *));
+  queue.n_free = 0;
+  queue.chunk_bytes = chunk_bytes;
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.not_empty, NULL);
+  pthread_cond_init(&queue.not_full, NULL);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  /* start the pool */
+  threads = malloc(n_threads * sizeof(pthread_t));
+  for (int i = 0; i < n_threads; i++) {
+    if (pthread_create(&threads[i], NULL, pool_thread, &queue) != 0) {
+      fprintf(stderr, "Could not start thread %d\n", i);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  while (true) {
+
+    /* wait for room, which stays free while the chunk is read as only this thread adds chunks */
+    pthread_mutex_lock(&queue.lock);
+    while (queue.count == queue.capacity)
+      pthread_cond_wait(&queue.not_full, &queue.lock);
+    pthread_mutex_unlock(&queue.lock);
+
+    /* read the next chunk without the lock, as it may wait on a pipe or open a file */
+    available = getChunkView(&view, chunk_bytes);
+
+    if (!available)
+      break;
+
+    /* the stream buffer is reused by the next read, the mapped files are not */
+    copy = NULL;
+    if (!view.stable && view.n_bytes > 0) {
+      pthread_mutex_lock(&queue.lock);
+      copy = take_copy(&queue);
+      pthread_mutex_unlock(&queue.lock);
+
+      memcpy(copy, view.bytes, view.n_bytes);
+      view.bytes = copy;
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    queue.items[(queue.head + queue.count) % queue.capacity].view = view;
+    queue.items[(queue.head + queue.count) % queue.capacity].copy = copy;
+    queue.count++;
+    pthread_cond_signal(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+  }
+
+  /* signal the pool that there is no more work to be done */
+  pthread_mutex_lock(&queue.lock);
+  queue.done = true;
+  pthread_cond_broadcast(&queue.not_empty);
+  pthread_mutex_unlock(&queue.lock);
+
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  for (int i = 0; i < queue.n_free; i++)
+    free(queue.free_copies[i]);
+  free(queue.free_copies);
+  free(queue.items);
+  free(threads);
+  pthread_mutex_destroy(&queue.lock);
+  pthread_mutex_destroy(&queue.merge_lock);
+  pthread_cond_destroy(&queue.not_empty);
+  pthread_cond_destroy(&queue.not_full);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
@@ -0,0 +1,19 @@
+/**
+ *  \file standalone.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the standalone mode, where a single process counts the chunks
+ *  in place with a pool of threads:
+ *     \li standalone_dispatcher.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef STANDALONE_H_
+#define STANDALONE_H_
+
+/** \brief Read the chunks and hand pointers to them to a pool of threads that count and merge them */
+extern void standalone_dispatcher(char *file_names[], unsigned int num_files, int n_threads, int chunk_bytes);
+
+#endif /* STANDALONE_H_ */
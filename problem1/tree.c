@@ -0,0 +1,359 @@
+/**
+ *  \file tree.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Tree mode, meant for jobs with many worker ranks. The processes that share a node are found with
+ *  MPI_Comm_split_type, and the first of them other than the root is the sub-dispatcher of the node.
+ *  The root only talks to the sub-dispatchers: it hands out large ranges (TREE_BYTES by default) on
+ *  demand, with MAX_IN_FLIGHT ranges queued per node. A sub-dispatcher cuts each range into one
+ *  slice per process of its node, sends the slices to its workers, counts the first slice itself,
+ *  merges the partial results in order and sends a single result up. So the work of the root grows
+ *  with the number of nodes, not with the number of workers.
+ *
+ *  Definition of the operations:
+ *     \li tree_dispatcher
+ *     \li tree_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <mpi.h>
+
+#include "probConst.h"
+#include "MessageStruct.h"
+#include "dispatcher.h"
+#include "worker.h"
+#include "partialResult.h"
+#include "tree.h"
+
+/** \brief tag of the slices sent to the workers of a node */
+#define TAG_SLICE   0
+
+/** \brief tag of the end signal sent to the workers of a node */
+#define TAG_STOP    1
+
+/**
+ *  \brief Find the team of the node of the process: the processes of the node other than the root,
+ *  the sub-dispatcher being the first of them.
+ *
+ *  Collective operation of all the processes. The root gets MPI_COMM_NULL.
+ *
+ *  \return communicator of the team.
+ */
+
+static MPI_Comm open_team() {
+
+  int rank;
+  MPI_Comm node, team;
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  /* ordered by world rank, so the first process of the team has the lowest rank of the node */
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+  MPI_Comm_split(node, rank == 0 ? MPI_UNDEFINED : 0, rank, &team);
+  MPI_Comm_free(&node);
+
+  return team;
+}
+
+/**
+ *  \brief Read the next range and post it to a sub-dispatcher, without waiting for the transfer.
+ *
+ *  Each sub-dispatcher owns a ring of MAX_IN_FLIGHT send buffers and returns its results in the
+ *  order it received the ranges, so when a result arrives the oldest buffer of that node is free.
+ *
+ *  \param sub index of the sub-dispatcher.
+ *  \param sub_ranks world rank of every sub-dispatcher.
+ *  \param ranges send buffers of all the sub-dispatchers.
+ *  \param requests pending send requests, one for each buffer.
+ *  \param next_slot next buffer to be used by each sub-dispatcher.
+ *  \param chunk_bytes size of the ranges.
+ *  \return true if a range was sent, false if there is no more data to read.
+ */
+
+static bool post_range(int sub, const int *sub_ranks, WireChunk **ranges, MPI_Request *requests, int *next_slot,
+                       int chunk_bytes) {
+
+  int slot = sub * MAX_IN_FLIGHT + next_slot[sub];
+
+  /* make sure the previous transfer from this buffer is over */
+  MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+
+  if (!getChunk(ranges[slot], chunk_bytes))
+    return false;
+
+  MPI_Isend(ranges[slot], WIRE_SIZE(ranges[slot]), MPI_BYTE, sub_ranks[sub], 0, MPI_COMM_WORLD, &requests[slot]);
+
+  next_slot[sub] = (next_slot[sub] + 1) % MAX_IN_FLIGHT;
+
+  return true;
+}
+
+/**
+ *  \brief tree dispatcher.
+ *
+ *  Demand-driven, as the hybrid dispatcher, but only with the sub-dispatchers of the nodes. The end
+ *  of the work is signalled with a range whose size is -1 on every buffer of each sub-dispatcher.
+ *
+ *  \param file_names array with the file names.
+ *  \param num_files number of files.
+ *  \param chunk_bytes size of the ranges.
+ */
+
+void tree_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes) {
+
+  struct timespec start, finish;
+  int size, n_subs = 0, n_slots, in_flight = 0;
+  bool data_left = true;
+  ChunkResult result;
+  MPI_Status status;
+  int is_sub = 0;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  /* the root belongs to no team */
+  open_team();
+
+  /* every process tells whether it is a sub-dispatcher */
+  int *sub_flags = malloc(size * sizeof(int));
+  int *sub_index = malloc(size * sizeof(int));
+  int *sub_ranks = malloc(size * sizeof(int));
+
+  MPI_Gather(&is_sub, 1, MPI_INT, sub_flags, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  for (int i = 1; i < size; i++)
+    if (sub_flags[i]) {
+      sub_index[i] = n_subs;
+      sub_ranks[n_subs++] = i;
+    }
+
+  n_slots = n_subs * MAX_IN_FLIGHT;
+
+  /* send buffers and requests of every sub-dispatcher */
+  WireChunk **ranges = malloc(n_slots * sizeof(WireChunk *));
+  MPI_Request *requests = malloc(n_slots * sizeof(MPI_Request));
+  int *next_slot = calloc(n_subs, sizeof(int));
+
+  for (int i = 0; i < n_slots; i++) {
+    ranges[i] = malloc(WIRE_BYTES(chunk_bytes));
+    requests[i] = MPI_REQUEST_NULL;
+  }
+
+  /* allocate memory */
+  allocateMemory(file_names, num_files);
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+
+  /* fill the queue of every node */
+  for (int depth = 0; depth < MAX_IN_FLIGHT && data_left; depth++)
+    for (int sub = 0; sub < n_subs && data_left; sub++) {
+      data_left = post_range(sub, sub_ranks, ranges, requests, next_slot, chunk_bytes);
+      if (data_left)
+        in_flight++;
+    }
+
+  /* collect results from whichever node finishes first and give it more work */
+  while (in_flight > 0) {
+
+    MPI_Recv(&result, sizeof(ChunkResult), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
+    in_flight--;
+
+    /* save results of the range */
+    save_file_results(&result);
+
+    if (data_left) {
+      data_left = post_range(sub_index[status.MPI_SOURCE], sub_ranks, ranges, requests, next_slot, chunk_bytes);
+      if (data_left)
+        in_flight++;
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  MPI_Waitall(n_slots, requests, MPI_STATUSES_IGNORE);
+
+  /* signal the sub-dispatchers that there is no more work to be done, on every buffer */
+  for (int slot = 0; slot < n_slots; slot++) {
+    ranges[slot]->header.n_bytes = -1;
+    MPI_Send(ranges[slot], sizeof(ChunkHeader), MPI_BYTE, sub_ranks[slot / MAX_IN_FLIGHT], 0, MPI_COMM_WORLD);
+  }
+
+  for (int i = 0; i < n_slots; i++)
+    free(ranges[i]);
+
+  free(ranges);
+  free(requests);
+  free(next_slot);
+  free(sub_flags);
+  free(sub_index);
+  free(sub_ranks);
+
+  /* print final results */
+  print_final_results();
+  print_elapsed(start, finish);
+}
+
+/**
+ *  \brief Process a range with the workers of the node.
+ *
+ *  The range is cut into one slice per process of the team, at any byte, but in slices of at least
+ *  NUM_BYTES. The slices are sent straight from the buffer of the range, the first one is counted
+ *  by the sub-dispatcher and the partial results are merged in order.
+ *
+ *  \param team communicator of the team, the sub-dispatcher being its first process.
+ *  \param team_size number of processes of the team.
+ *  \param bytes bytes of the range.
+ *  \param n_bytes number of bytes of the range.
+ *  \param results partial results of the slices, one per process of the team.
+ *  \param requests send requests of the slices, one per process of the team.
+ *  \param result merged partial results of the range.
+ */
+
+static void split_range(MPI_Comm team, int team_size, const unsigned char *bytes, int n_bytes, ChunkResult *results,
+                        MPI_Request *requests, ChunkResult *result) {
+
+  int n_slices = n_bytes / NUM_BYTES < team_size ? n_bytes / NUM_BYTES : team_size;
+
+  if (n_slices < 1)
+    n_slices = 1;
+
+  for (int i = 1; i < n_slices; i++) {
+    int begin = (int)((long long)n_bytes * i / n_slices), end = (int)((long long)n_bytes * (i + 1) / n_slices);
+    MPI_Isend(bytes + begin, end - begin, MPI_BYTE, i, TAG_SLICE, team, &requests[i]);
+  }
+
+  processChunk(bytes, (int)((long long)n_bytes / n_slices), &results[0]);
+
+  for (int i = 1; i < n_slices; i++)
+    MPI_Recv(&results[i], sizeof(ChunkResult), MPI_BYTE, i, 0, team, MPI_STATUS_IGNORE);
+
+  /* the slices were received before their results were sent */
+  MPI_Waitall(n_slices - 1, &requests[1], MPI_STATUSES_IGNORE);
+
+  /* merge the slices in order */
+  *result = results[0];
+  for (int i = 1; i < n_slices; i++)
+    result_merge(result, &results[i], result);
+}
+
+/**
+ *  \brief Sub-dispatcher of a node.
+ *
+ *  Keeps MAX_IN_FLIGHT ranges posted, so the next range can arrive while the current one is split
+ *  among the workers of the node, and sends up one result per range.
+ *
+ *  \param team communicator of the team.
+ *  \param chunk_bytes size of the ranges.
+ */
+
+static void sub_dispatcher(MPI_Comm team, int chunk_bytes) {
+
+  int team_size, slot = 0;
+  WireChunk *ranges[MAX_IN_FLIGHT];
+  MPI_Request requests[MAX_IN_FLIGHT];
+  ChunkResult result;
+
+  MPI_Comm_size(team, &team_size);
+
+  ChunkResult *results = malloc(team_size * sizeof(ChunkResult));
+  MPI_Request *slice_requests = malloc(team_size * sizeof(MPI_Request));
+
+  /* post the receives of every buffer */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+    ranges[i] = malloc(WIRE_BYTES(chunk_bytes));
+    MPI_Irecv(ranges[i], WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &requests[i]);
+  }
+
+  /* ranges arrive in order, one buffer after the other */
+  while (true) {
+
+    MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+
+    /* if no more work */
+    if (ranges[slot]->header.n_bytes < 0)
+      break;
+
+    split_range(team, team_size, ranges[slot]->bytes, ranges[slot]->header.n_bytes, results, slice_requests, &result);
+
+    result.file_index = ranges[slot]->header.file_index;
+    result.chunk_index = ranges[slot]->header.chunk_index;
+
+    /* the buffer is free again before the dispatcher gets the result */
+    MPI_Irecv(ranges[slot], WIRE_BYTES(chunk_bytes), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &requests[slot]);
+
+    MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+
+    slot = (slot + 1) % MAX_IN_FLIGHT;
+  }
+
+  /* the other buffers also receive the end signal */
+  for (int i = 0; i < MAX_IN_FLIGHT; i++) {
+    if (i != slot)
+      MPI_Wait(&requests[i], MPI_STATUS_IGNORE);
+    free(ranges[i]);
+  }
+
+  /* signal the workers of the node that there is no more work to be done */
+  for (int i = 1; i < team_size; i++)
+    MPI_Send(NULL, 0, MPI_BYTE, i, TAG_STOP, team);
+
+  free(results);
+  free(slice_requests);
+}
+
+/**
+ *  \brief tree worker.
+ *
+ *  The sub-dispatcher of the node splits the ranges of the root; the other processes count the
+ *  slices they receive from it and send their partial results back.
+ *
+ *  \param rank worker id.
+ *  \param chunk_bytes size of the ranges.
+ */
+
+void tree_worker(int rank, int chunk_bytes) {
+
+  MPI_Comm team = open_team();
+  MPI_Status status;
+  ChunkResult result;
+  int team_rank, n_bytes;
+  int is_sub;
+
+  MPI_Comm_rank(team, &team_rank);
+
+  is_sub = team_rank == 0;
+  MPI_Gather(&is_sub, 1, MPI_INT, NULL, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  if (is_sub) {
+    sub_dispatcher(team, chunk_bytes);
+    MPI_Comm_free(&team);
+    return;
+  }
+
+  unsigned char *slice = malloc(chunk_bytes);
+
+  while (true) {
+
+    MPI_Recv(slice, chunk_bytes, MPI_BYTE, 0, MPI_ANY_TAG, team, &status);
+
+    /* if no more work */
+    if (status.MPI_TAG == TAG_STOP)
+      break;
+
+    MPI_Get_count(&status, MPI_BYTE, &n_bytes);
+
+    processChunk(slice, n_bytes, &result);
+
+    MPI_Send(&result, sizeof(ChunkResult), MPI_BYTE, 0, 0, team);
+  }
+
+  free(slice);
+  MPI_Comm_free(&team);
+}
@@ -0,0 +1,23 @@
+/**
+ *  \file tree.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the operations of the tree mode, where the root hands large ranges to one
+ *  sub-dispatcher per node, which splits them among the workers of its node:
+ *     \li tree_dispatcher
+ *     \li tree_worker.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef TREE_H_
+#define TREE_H_
+
+/** \brief Send large ranges to the sub-dispatchers on demand and gather their results */
+extern void tree_dispatcher(char *file_names[], unsigned int num_files, int chunk_bytes);
+
+/** \brief Split the ranges among the workers of the node, or process the slices of the sub-dispatcher */
+extern void tree_worker(int rank, int chunk_bytes);
+
+#endif /* TREE_H_ */
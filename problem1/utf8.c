@@ -0,0 +1,169 @@
+/**
+ *  \file utf8.c (implementation file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *
+ *  Definition of the UTF-8 operations shared by the dispatcher and the workers:
+ *     \li utf8_length
+ *     \li utf8_step
+ *     \li utf8_decode
+ *     \li utf8_encode
+ *     \li utf8_is_continuation.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#include "utf8.h"
+
+/** 
+ *  \brief Get the number of bytes of a character from its lead byte.
+ * 
+ *  \param lead first byte of the character.
+ *  \return number of bytes, from 1 to 4.
+ */
+
+int utf8_length(unsigned char lead) {
+  if ((lead & 0x80) == 0)
+    return 1;
+  if ((lead & 0xF0) == 0xF0)
+    return 4;
+  if ((lead & 0xE0) == 0xE0)
+    return 3;
+  return 2;
+}
+
+/** \brief byte classes of the decoder automaton */
+static const unsigned char byte_classes[256] = {
+  /* 00-7F: ASCII */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  /* 80-8F, 90-9F, A0-BF: continuation bytes */
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,  3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+  /* C0-C1: invalid, C2-DF: lead of 2 bytes */
+  11, 11, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  /* E0, E1-EC, ED, EE-EF: lead of 3 bytes; F0, F1-F3, F4: lead of 4 bytes; F5-FF: invalid */
+  5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 6, 6,  8, 9, 9, 9, 10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11
+};
+
+/** \brief bits of the value kept from a lead byte of each class */
+static const unsigned char lead_masks[12] = { 0x7F, 0, 0, 0, 0x1F, 0x0F, 0x0F, 0x0F, 0x07, 0x07, 0x07, 0 };
+
+/** \brief next state of the decoder automaton for each state and byte class */
+static const unsigned char transitions[UTF8_STATES][12] = {
+  /*                  00  80  90  A0  C2  E0  E1  ED  F0  F1  F4  bad */
+  /* ACCEPT */      {  0,  1,  1,  1,  2,  5,  3,  6,  7,  4,  8,  1 },
+  /* REJECT */      {  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* 1 byte left */ {  1,  0,  0,  0,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* 2 bytes left */{  1,  2,  2,  2,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* 3 bytes left */{  1,  3,  3,  3,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* after E0 */    {  1,  1,  1,  2,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* after ED */    {  1,  2,  2,  1,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* after F0 */    {  1,  1,  3,  3,  1,  1,  1,  1,  1,  1,  1,  1 },
+  /* after F4 */    {  1,  3,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1 },
+};
+
+/** 
+ *  \brief Feed one byte to the decoder automaton.
+ * 
+ *  \param state state of the automaton, UTF8_ACCEPT at the start of a char.
+ *  \param ch_value value of the char being decoded.
+ *  \param byte next byte.
+ *  \return new state: UTF8_ACCEPT once the char is complete, UTF8_REJECT if the byte is not valid.
+ */
+
+int utf8_step(int state, int *ch_value, unsigned char byte) {
+
+  int byte_class = byte_classes[byte];
+
+  if (state == UTF8_ACCEPT)
+    *ch_value = byte & lead_masks[byte_class];
+  else
+    *ch_value = (*ch_value << 6) | (byte & 0x3F);
+
+  return transitions[state][byte_class];
+}
+
+/** 
+ *  \brief Decode the character that starts at a given position of a byte buffer.
+ *  
+ *  The bytes are walked through the decoder automaton. An invalid sequence is replaced by
+ *  UTF8_REPLACEMENT and decoding goes on at the byte that made it invalid.
+ * 
+ *  \param bytes buffer with UTF-8 encoded text.
+ *  \param n_bytes number of bytes in the buffer.
+ *  \param pos position of the lead byte, advanced past the character.
+ *  \return character value, or -1 if the buffer ends in the middle of the character.
+ */
+
+int utf8_decode(const unsigned char *bytes, int n_bytes, int *pos) {
+
+  int state = UTF8_ACCEPT;
+  int ch_value = 0;
+
+  for (int x = *pos; x < n_bytes; x++) {
+
+    state = utf8_step(state, &ch_value, bytes[x]);
+
+    if (state == UTF8_ACCEPT) {
+      *pos = x + 1;
+      return ch_value;
+    }
+
+    if (state == UTF8_REJECT) {
+      *pos = x > *pos ? x : x + 1;
+      return UTF8_REPLACEMENT;
+    }
+  }
+
+  return -1;
+}
+
+/** 
+ *  \brief Encode a character in UTF-8.
+ *  
+ *  \param ch_value character to be encoded, a valid code point.
+ *  \param bytes buffer with room for 4 bytes.
+ *  \return number of bytes written.
+ */
+
+int utf8_encode(int ch_value, unsigned char *bytes) {
+
+  if (ch_value < 0x80) {
+    bytes[0] = ch_value;
+    return 1;
+  }
+
+  if (ch_value < 0x800) {
+    bytes[0] = 0xC0 | (ch_value >> 6);
+    bytes[1] = 0x80 | (ch_value & 0x3F);
+    return 2;
+  }
+
+  if (ch_value < 0x10000) {
+    bytes[0] = 0xE0 | (ch_value >> 12);
+    bytes[1] = 0x80 | ((ch_value >> 6) & 0x3F);
+    bytes[2] = 0x80 | (ch_value & 0x3F);
+    return 3;
+  }
+
+  bytes[0] = 0xF0 | (ch_value >> 18);
+  bytes[1] = 0x80 | ((ch_value >> 12) & 0x3F);
+  bytes[2] = 0x80 | ((ch_value >> 6) & 0x3F);
+  bytes[3] = 0x80 | (ch_value & 0x3F);
+  return 4;
+}
+
+/** 
+ *  \brief Check if a byte continues a multi-byte character.
+ *  
+ *  \param byte byte to be checked.
+ *  \return 1 if it is a continuation byte, 0 otherwise.
+ */
+
+int utf8_is_continuation(unsigned char byte) {
+  return (byte & 0xC0) == 0x80;
+}
@@ -0,0 +1,46 @@
+/**
+ *  \file utf8.h (interface file)
+ *
+ *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
+ *
+ *  Definition of the UTF-8 operations shared by the dispatcher and the workers:
+ *     \li utf8_length
+ *     \li utf8_step
+ *     \li utf8_decode
+ *     \li utf8_encode
+ *     \li utf8_is_continuation.
+ *
+ *  \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+#ifndef UTF8_H_
+#define UTF8_H_
+
+/** \brief state of the decoder automaton at the start and end of a char */
+#define UTF8_ACCEPT        0
+
+/** \brief state of the decoder automaton after an invalid byte */
+#define UTF8_REJECT        1
+
+/** \brief number of states of the decoder automaton */
+#define UTF8_STATES        9
+
+/** \brief char that replaces an invalid sequence */
+#define UTF8_REPLACEMENT   0xFFFD
+
+/** \brief Number of bytes of the character that starts with a given lead byte */
+extern int utf8_length(unsigned char lead);
+
+/** \brief Feed one byte to the decoder automaton */
+extern int utf8_step(int state, int *ch_value, unsigned char byte);
+
+/** \brief Decode the character starting at bytes[*pos] and advance *pos past it */
+extern int utf8_decode(const unsigned char *bytes, int n_bytes, int *pos);
+
+/** \brief Encode a character in UTF-8, returning the number of bytes */
+extern int utf8_encode(int ch_value, unsigned char *bytes);
+
+/** \brief Check if a byte is a continuation byte of a multi-byte character */
+extern int utf8_is_continuation(unsigned char byte);
+
+#endif /* UTF8_H_ */
@@ -5,10 +5,15 @@
  *
  *
  *  Definition of the operations carried out by the workers:
+ *      \li char_class
  *      \li is_vowel
  *      \li is_consonant
  *      \li is_split
- *      \li processVal.
+ *      \li boundary_class
+ *      \li reset_state
+ *      \li processVal
+ *      \li processBytes
+ *      \li processChunk.
  *
  *  \author Eduardo Santos and Pedro Bastos - May 2022
  */
@@ -24,13 +29,80 @@
 
 #include "probConst.h"
 #include "MessageStruct.h"
+#include "utf8.h"
+#include "worker.h"
+#include "asciiKernel.h"
+
+/** \brief class flags of the Latin-1 chars, indexed by char value */
+static const unsigned char char_classes[256] = {
+  /* split chars */
+  [9] = CLASS_SPLIT, [10] = CLASS_SPLIT, [32] = CLASS_SPLIT, [33] = CLASS_SPLIT, [34] = CLASS_SPLIT,
+  [40] = CLASS_SPLIT, [41] = CLASS_SPLIT, [44] = CLASS_SPLIT, [45] = CLASS_SPLIT, [46] = CLASS_SPLIT,
+  [58] = CLASS_SPLIT, [59] = CLASS_SPLIT, [63] = CLASS_SPLIT, [91] = CLASS_SPLIT, [93] = CLASS_SPLIT,
+  [96] = CLASS_SPLIT, [123] = CLASS_SPLIT, [125] = CLASS_SPLIT, [171] = CLASS_SPLIT, [187] = CLASS_SPLIT,
+
+  /* apostrophe */
+  [39] = CLASS_APOSTROPHE,
+
+  /* vowels */
+  ['A'] = CLASS_VOWEL, ['E'] = CLASS_VOWEL, ['I'] = CLASS_VOWEL, ['O'] = CLASS_VOWEL, ['U'] = CLASS_VOWEL,
+  ['a'] = CLASS_VOWEL, ['e'] = CLASS_VOWEL, ['i'] = CLASS_VOWEL, ['o'] = CLASS_VOWEL, ['u'] = CLASS_VOWEL,
+  [192] = CLASS_VOWEL, [193] = CLASS_VOWEL, [194] = CLASS_VOWEL, [195] = CLASS_VOWEL, [200] = CLASS_VOWEL,
+  [201] = CLASS_VOWEL, [202] = CLASS_VOWEL, [204] = CLASS_VOWEL, [205] = CLASS_VOWEL, [206] = CLASS_VOWEL,
+  [210] = CLASS_VOWEL, [211] = CLASS_VOWEL, [212] = CLASS_VOWEL, [213] = CLASS_VOWEL, [217] = CLASS_VOWEL,
+  [218] = CLASS_VOWEL, [219] = CLASS_VOWEL, [224] = CLASS_VOWEL, [225] = CLASS_VOWEL, [226] = CLASS_VOWEL,
+  [227] = CLASS_VOWEL, [232] = CLASS_VOWEL, [233] = CLASS_VOWEL, [234] = CLASS_VOWEL, [236] = CLASS_VOWEL,
+  [237] = CLASS_VOWEL, [238] = CLASS_VOWEL, [242] = CLASS_VOWEL, [243] = CLASS_VOWEL, [244] = CLASS_VOWEL,
+  [245] = CLASS_VOWEL, [249] = CLASS_VOWEL, [250] = CLASS_VOWEL, [251] = CLASS_VOWEL,
+
+  /* consonants */
+  ['B'] = CLASS_CONSONANT, ['C'] = CLASS_CONSONANT, ['D'] = CLASS_CONSONANT, ['F'] = CLASS_CONSONANT,
+  ['G'] = CLASS_CONSONANT, ['H'] = CLASS_CONSONANT, ['J'] = CLASS_CONSONANT, ['K'] = CLASS_CONSONANT,
+  ['L'] = CLASS_CONSONANT, ['M'] = CLASS_CONSONANT, ['N'] = CLASS_CONSONANT, ['P'] = CLASS_CONSONANT,
+  ['Q'] = CLASS_CONSONANT, ['R'] = CLASS_CONSONANT, ['S'] = CLASS_CONSONANT, ['T'] = CLASS_CONSONANT,
+  ['V'] = CLASS_CONSONANT, ['W'] = CLASS_CONSONANT, ['X'] = CLASS_CONSONANT, ['Y'] = CLASS_CONSONANT,
+  ['Z'] = CLASS_CONSONANT,
+  ['b'] = CLASS_CONSONANT, ['c'] = CLASS_CONSONANT, ['d'] = CLASS_CONSONANT, ['f'] = CLASS_CONSONANT,
+  ['g'] = CLASS_CONSONANT, ['h'] = CLASS_CONSONANT, ['j'] = CLASS_CONSONANT, ['k'] = CLASS_CONSONANT,
+  ['l'] = CLASS_CONSONANT, ['m'] = CLASS_CONSONANT, ['n'] = CLASS_CONSONANT, ['p'] = CLASS_CONSONANT,
+  ['q'] = CLASS_CONSONANT, ['r'] = CLASS_CONSONANT, ['s'] = CLASS_CONSONANT, ['t'] = CLASS_CONSONANT,
+  ['v'] = CLASS_CONSONANT, ['w'] = CLASS_CONSONANT, ['x'] = CLASS_CONSONANT, ['y'] = CLASS_CONSONANT,
+  ['z'] = CLASS_CONSONANT,
+  [199] = CLASS_CONSONANT, [231] = CLASS_CONSONANT,
+};
 
-/** \brief variables used in the computation of each file */
-int flag = 0;
-int value_before = 0;
-int end_of_word = 0;
-int end = 0;
+/** 
+ *  \brief Get the class flags of a given char.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param char_value character value to be classified.
+ *  \return combination of the CLASS_ flags, 0 if the char has no class.
+ */
 
+int char_class(int char_value) {
+
+  /* Latin-1 chars are looked up in the table */
+  if (char_value >= 0 && char_value < 256)
+    return char_classes[char_value];
+
+  /* typographic punctuation */
+  switch (char_value) {
+    case 8211:                                                                                  /* en dash */
+    case 8212:                                                                                  /* em dash */
+    case 8220:                                                                       /* left double quote */
+    case 8221:                                                                      /* right double quote */
+    case 8230:                                                                                /* ellipsis */
+      return CLASS_SPLIT;
+
+    case 8216:                                                                       /* left single quote */
+    case 8217:                                                                      /* right single quote */
+      return CLASS_APOSTROPHE;
+
+    default:
+      return 0;
+  }
+}
 
 /** 
  *  \brief Check if a given char is a vowel.
@@ -42,18 +114,7 @@ int end = 0;
  */
 
 int is_vowel(int char_value) {
-  /* list of all the vowels values */
-  int vowels[] = {97, 101, 105, 111, 117, 65, 69, 73, 79, 85, 224, 225, 226, 227, 232, 233, 234, 236, 237, 238,
-                  242, 243, 244, 245, 249, 250, 192, 193, 194, 195, 200, 201, 202, 204, 205, 206, 210,
-                  211, 212, 213, 217, 218, 219, 251};
-
-  /* go through the list and check if it contains the given char */
-  for (int i = 0; i < sizeof(vowels) / sizeof(vowels[0]); i++)
-    if (vowels[i] == char_value) {
-      return 1;
-    }
-
-  return 0;
+  return (char_class(char_value) & CLASS_VOWEL) != 0;
 }
 
 /** 
@@ -66,17 +127,7 @@ int is_vowel(int char_value) {
  */
 
 int is_consonant(int char_value) {
-  /* list of all the consonants values */
-  int consonants[] = {98, 99, 100, 102, 103, 104, 106, 107, 108, 109, 110, 112, 113, 114, 115, 116, 118, 119, 120, 121, 122,
-                      66, 67, 68, 70, 71, 72, 74, 75, 76, 77, 78, 80, 81, 82, 83, 84, 86, 87, 88, 89, 90,
-                      231, 199};
-
-  /* go through the list and check if it contains the given char */
-  for (int i = 0; i < sizeof(consonants) / sizeof(consonants[0]); i++)
-    if (consonants[i] == char_value)
-      return 1;
-
-  return 0;
+  return (char_class(char_value) & CLASS_CONSONANT) != 0;
 }
 
 /** 
@@ -89,34 +140,80 @@ int is_consonant(int char_value) {
  */
 
 int is_split(int char_value) {
-  /* list of all the split char values */
-  int splits[] = {32, 9, 10, 45, 34, 8220, 8221, 91, 93, 123, 125, 40, 41, 46, 44,
-                  58, 59, 63, 33, 8211, 8212, 8230, 171, 187, 96};
+  return (char_class(char_value) & CLASS_SPLIT) != 0;
+}
 
-  /* go through the list and check if it contains the given char */
-  for (int i = 0; i < sizeof(splits) / sizeof(splits[0]); i++)
-    if (splits[i] == char_value)
-      return 1;
+#if METRICS
+/** 
+ *  \brief Count a char in the metrics that add up char by char.
+ * 
+ *  \param metrics metrics of the text.
+ *  \param ch_value character value.
+ *  \param ch_class class flags of the char.
+ */
 
-  return 0;
+static void count_metrics(Metrics *metrics, int ch_value, int ch_class) {
+
+#if METRICS & METRIC_CLASSES
+    if (ch_class & CLASS_VOWEL)
+        metrics->classes[0] += 1;
+    else if (ch_class & CLASS_CONSONANT)
+        metrics->classes[1] += 1;
+    else if (ch_class & CLASS_SPLIT)
+        metrics->classes[2] += 1;
+    else if (ch_class & CLASS_APOSTROPHE)
+        metrics->classes[3] += 1;
+    else
+        metrics->classes[4] += 1;
+#endif
+
+#if METRICS & METRIC_LINES
+    if (ch_value == '\n')
+        metrics->lines += 1;
+#endif
 }
+#endif
 
+#if METRICS & METRIC_LENGTHS
 /** 
- *  \brief Process each file chunk.
+ *  \brief Count the length of the word ended by a split char.
+ *
+ *  The first word of a text may have started before it, so its length is only kept in the state,
+ *  to be completed when the text is merged with the text before it.
+ * 
+ *  \param metrics metrics of the text.
+ *  \param state state left by the chars before the split char.
+ */
+
+static void end_word(Metrics *metrics, WordState *state) {
+
+    if (!state->head_ends) {
+        state->head_ends = 1;
+        state->head_length = state->word_length;
+        state->head_zero = state->value_before == 0;
+    }
+    else if (!(state->class_before & CLASS_SPLIT) && state->value_before != 0) {
+        metrics->lengths[state->word_length < METRIC_MAX_LENGTH ? state->word_length : METRIC_MAX_LENGTH] += 1;
+        metrics->length_total += state->word_length;
+    }
+
+    state->word_length = 0;
+}
+#endif
+
+/** 
+ *  \brief Count the chars of a chunk, continuing from a given state.
  *  
  *  Operation carried out by the workers.
  * 
- *  \param messageStruct structure that contains the chunk information.
+ *  \param messageStruct structure that contains the chunk chars, whose counters are incremented.
+ *  \param state state left by the previous chars, updated to the end of the chunk.
  */
 
-void processVal(MessageStruct *messageStruct) {
-
-    /* initialize struct variables */
-    messageStruct->num_cons = 0;
-    messageStruct->num_vowels = 0;
-    messageStruct->num_words = 0;
+static void count_values(MessageStruct *messageStruct, WordState *state) {
 
     int ch_value = 0;
+    int ch_class;
 
     for (int counter = 0; counter < messageStruct->n_bytes_read; counter++) {                                         
 
@@ -128,64 +225,378 @@ void processVal(MessageStruct *messageStruct) {
             break;
         }
 
+        /* single lookup of the char class */
+        ch_class = char_class(ch_value);
+
+#if METRICS
+        count_metrics(&messageStruct->metrics, ch_value, ch_class);
+#endif
+
         /* check if first char of file is vowel */
-        if (flag == 0) {
-            if (is_vowel(ch_value) == 1) {
+        if (state->flag == 0) {
+            if (ch_class & CLASS_VOWEL) {
                 messageStruct->num_vowels += 1;
             }
-            flag = 1;
+            state->flag = 1;
         }
 
         /* check if is a lonely apostrophe to avoid counting as word */
-        if (ch_value == 39 || ch_value == 8216 || ch_value == 8217) {
-            if (is_split(value_before))
+        if (ch_class & CLASS_APOSTROPHE) {
+            if (state->class_before & CLASS_SPLIT)
                 continue;
         }
 
         /* if is split char */
-        if (is_split(ch_value)) {
+        if (ch_class & CLASS_SPLIT) {
 
             /* check if previous char was a consonant */
-            if (is_consonant(value_before))
+            if (state->class_before & CLASS_CONSONANT)
                 messageStruct->num_cons += 1;
 
-            end_of_word = 1;
+            state->end_of_word = 1;
+
+#if METRICS & METRIC_LENGTHS
+            end_word(&messageStruct->metrics, state);
+#endif
 
-            /* avoid consequent split chars */
-            if(!is_split(value_before) && value_before != 0)
-                end = 1;
+            /* avoid consequent split chars, if end of word */
+            if(!(state->class_before & CLASS_SPLIT) && state->value_before != 0)
+                messageStruct->num_words += 1;
 
         }
 
         /* not a split chat */
         else{
-            end = 0;
+
+#if METRICS & METRIC_LENGTHS
+            state->word_length += 1;
+#endif
 
             /* check if is end of word to sum total words */
-            if (end_of_word == 1) {
+            if (state->end_of_word == 1) {
 
-                end_of_word = 0;
+                state->end_of_word = 0;
 
                 /* if first char of new word is vowel */
-                if (is_vowel(ch_value) == 1){
+                if (ch_class & CLASS_VOWEL){
                     messageStruct->num_vowels += 1;
                 }
             }
         }
 
-        /* if end of word */
-        if(end == 1){
-            messageStruct->num_words += 1;
-            end = 0;
+        /* save previous char to check in next iteration */
+        state->value_before = ch_value;
+        state->class_before = ch_class;
+    }
+}
+
+/** 
+ *  \brief Reset the state kept between the chars of a text.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param state state to be reset.
+ */
+
+void reset_state(WordState *state) {
+    state->flag = 0;
+    state->value_before = 0;
+    state->class_before = 0;
+    state->end_of_word = 0;
+#if METRICS & METRIC_LENGTHS
+    state->word_length = 0;
+    state->head_length = 0;
+    state->head_ends = 0;
+    state->head_zero = 0;
+#endif
+}
+
+/** 
+ *  \brief Process each file chunk.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param messageStruct structure that contains the chunk information.
+ */
+
+void processVal(MessageStruct *messageStruct) {
+
+    WordState state;
+
+    /* initialize struct variables */
+    messageStruct->num_cons = 0;
+    messageStruct->num_vowels = 0;
+    messageStruct->num_words = 0;
+
+    reset_state(&state);
+    count_values(messageStruct, &state);
+}
+
+/** 
+ *  \brief Count a buffer of UTF-8 encoded text, continuing from a given state.
+ *
+ *  Pure ASCII buffers are counted by the vectorized kernel when the CPU supports it. Otherwise the
+ *  text is decoded into pieces of about NUM_BYTES characters, always cut after a split char, and
+ *  counted as one continuous sequence. Unless it is the final buffer, the trailing incomplete
+ *  word is left uncounted so the caller can prepend it to the next buffer.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param bytes buffer with the text.
+ *  \param n_bytes number of bytes in the buffer.
+ *  \param final 1 if no more text follows the buffer, 0 otherwise.
+ *  \param state state left by the previous text, updated to the last char counted.
+ *  \param messageStruct structure used to decode the pieces, which receives the totals.
+ *  \return number of bytes processed.
+ */
+
+static int count_bytes(const unsigned char *bytes, int n_bytes, int final, WordState *state, MessageStruct *messageStruct) {
+
+    int pos = 0, consumed = 0;
+    int count = 0;
+    int last_split = 0, last_split_pos = 0;
+    int ch_value;
+    int full;
+
+    /* initialize struct variables */
+    messageStruct->num_cons = 0;
+    messageStruct->num_vowels = 0;
+    messageStruct->num_words = 0;
+
+#if METRICS
+    memset(&messageStruct->metrics, 0, sizeof(Metrics));
+#else
+    /* fast path for text without multi-byte chars, which keeps no metrics */
+    if (ascii_kernel(bytes, n_bytes, final, &consumed, state, messageStruct))
+        return consumed;
+#endif
+
+    while (pos < n_bytes) {
+
+        ch_value = utf8_decode(bytes, n_bytes, &pos);
+
+        /* if the buffer ends in the middle of a char */
+        if (ch_value == -1)
+            break;
+
+        messageStruct->ch_values[count++] = ch_value;
+
+        if (is_split(ch_value)) {
+            last_split = count;
+            last_split_pos = pos;
         }
 
-        /* save previous char to check in next iteration */
-        value_before = ch_value;
+        full = count == NUM_BYTES + 10;
+
+        /* if the piece is full without ending in a split char, cut it after the last one */
+        if (full && last_split != count) {
+            if (last_split == 0) {
+                last_split = count;
+                last_split_pos = pos;
+            }
+            pos = last_split_pos;
+            count = last_split;
+        }
+
+        /* count the piece once it is big enough and ends in a split char */
+        if ((count >= NUM_BYTES || full) && last_split == count) {
+            messageStruct->n_bytes_read = count;
+            count_values(messageStruct, state);
+            consumed = pos;
+            count = last_split = 0;
+        }
+    }
+
+    /* count what is left: everything if final, up to the last split char otherwise */
+    if (final) {
+        last_split = count;
+        last_split_pos = n_bytes;
+    }
+
+    if (last_split > 0) {
+        messageStruct->n_bytes_read = last_split;
+        count_values(messageStruct, state);
+        consumed = last_split_pos;
     }
 
-    /* reset temporary variables */
-    flag = 0;
-    value_before = 0;
-    end_of_word = 0;
+    return consumed;
+}
+
+/** 
+ *  \brief Process a buffer of UTF-8 encoded text.
+ *
+ *  The buffer is counted from the start of a text, so it should begin right after a split char.
+ *  Unless it is the final buffer, the trailing incomplete word is left unprocessed so the caller
+ *  can prepend it to the next buffer.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param bytes buffer with the text.
+ *  \param n_bytes number of bytes in the buffer.
+ *  \param final 1 if no more text follows the buffer, 0 otherwise.
+ *  \param messageStruct structure used to decode the pieces, which receives the totals.
+ *  \return number of bytes processed.
+ */
+
+int processBytes(const unsigned char *bytes, int n_bytes, int final, MessageStruct *messageStruct) {
+
+    WordState state;
+
+    reset_state(&state);
 
-}
\ No newline at end of file
+    return count_bytes(bytes, n_bytes, final, &state, messageStruct);
+}
+
+/** 
+ *  \brief Get the class of a char as kept at the boundaries of a partial result.
+ * 
+ *  \param char_value character value.
+ *  \return class flags, with CLASS_ZERO for the char 0.
+ */
+
+int boundary_class(int char_value) {
+    return char_class(char_value) | (char_value == 0 ? CLASS_ZERO : 0);
+}
+
+#if METRICS
+/** 
+ *  \brief Add the metrics of the chars of a chunk after its first char, and of that char, to the
+ *  metrics of the chunk, and keep the words cut by its boundaries.
+ * 
+ *  \param metrics metrics of the chunk.
+ *  \param counted metrics of the chars after the first char.
+ *  \param state state left by the last char of the chunk.
+ *  \param first_value first char that is not an apostrophe.
+ */
+
+static void add_chunk_metrics(Metrics *metrics, const Metrics *counted, const WordState *state, int first_value) {
+
+    count_metrics(metrics, first_value, char_class(first_value));
+
+#if METRICS & METRIC_CLASSES
+    for (int i = 0; i < METRIC_N_CLASSES; i++)
+        metrics->classes[i] += counted->classes[i];
+#endif
+
+#if METRICS & METRIC_LINES
+    metrics->lines += counted->lines;
+#endif
+
+#if METRICS & METRIC_LENGTHS
+    memcpy(metrics->lengths, counted->lengths, sizeof(metrics->lengths));
+    metrics->length_total = counted->length_total;
+    metrics->head_ends = state->head_ends;
+    metrics->head_length = state->head_ends ? state->head_length : state->word_length;
+    metrics->head_zero = state->head_zero;
+    metrics->tail_length = state->word_length;
+#endif
+}
+#endif
+
+/** 
+ *  \brief Process a chunk cut at any byte offset of a file.
+ *
+ *  The words that lie inside the chunk are counted and the state at both boundaries is kept, so
+ *  the result can later be merged with the results of the neighbouring chunks. Up to 3 continuation
+ *  bytes at the start are kept as head bytes, and the last bytes as tail bytes only when they are
+ *  the valid start of a char. It is left to the merge to join them, or to decode them as
+ *  UTF8_REPLACEMENT when they do not form a char.
+ *  
+ *  Operation carried out by the workers.
+ * 
+ *  \param bytes chunk of UTF-8 encoded text.
+ *  \param n_bytes number of bytes in the chunk.
+ *  \param result partial results of the chunk.
+ */
+
+void processChunk(const unsigned char *bytes, int n_bytes, ChunkResult *result) {
+
+    /* structure used to decode the text */
+    MessageStruct messageStruct;
+
+    WordState state;
+    int pos = 0, end = n_bytes, limit;
+    int ch_value = -1;
+
+    result->num_words = 0;
+    result->num_vowels = 0;
+    result->num_cons = 0;
+    result->lead_apostrophes = 0;
+    result->first_class = CLASS_NONE;
+    result->last_class = CLASS_NONE;
+    result->n_head_bytes = 0;
+    result->n_tail_bytes = 0;
+    result->n_bytes = n_bytes;
+    result->compute_time = 0;
+#if METRICS
+    memset(&result->metrics, 0, sizeof(Metrics));
+#endif
+
+    /* end of a char that started in the previous chunk */
+    while (pos < n_bytes && result->n_head_bytes < 3 && utf8_is_continuation(bytes[pos]))
+        result->head_bytes[result->n_head_bytes++] = bytes[pos++];
+
+    /* start of a char that continues in the next chunk, only if the next bytes can still complete it */
+    for (int back = 1; back <= 3 && end - back >= pos; back++) {
+        if (!utf8_is_continuation(bytes[end - back])) {
+            int prefix = UTF8_ACCEPT, value;
+
+            for (int i = end - back; i < end; i++)
+                prefix = utf8_step(prefix, &value, bytes[i]);
+
+            if (prefix != UTF8_ACCEPT && prefix != UTF8_REJECT) {
+                memcpy(result->tail_bytes, bytes + end - back, back);
+                result->n_tail_bytes = back;
+                end -= back;
+            }
+            break;
+        }
+    }
+
+    /* a char cut short before the tail bytes is rejected by their lead byte, which is decoded with
+       the chars so that it does, as it never completes a char on its own */
+    limit = end + (result->n_tail_bytes > 0);
+
+    /* apostrophes before the first other char */
+    while (pos < end) {
+        ch_value = utf8_decode(bytes, limit, &pos);
+
+        if (!(char_class(ch_value) & CLASS_APOSTROPHE))
+            break;
+
+        result->lead_apostrophes += 1;
+#if METRICS
+        count_metrics(&result->metrics, ch_value, CLASS_APOSTROPHE);
+#endif
+        ch_value = -1;
+    }
+
+    /* if the chunk has no other char */
+    if (ch_value == -1)
+        return;
+
+    result->first_class = boundary_class(ch_value);
+
+    /* count the rest of the chunk after its first char */
+    state.flag = 1;
+    state.value_before = ch_value;
+    state.class_before = char_class(ch_value);
+    state.end_of_word = is_split(ch_value);
+#if METRICS & METRIC_LENGTHS
+    state.word_length = is_split(ch_value) ? 0 : 1;
+    state.head_length = 0;
+    state.head_ends = is_split(ch_value);
+    state.head_zero = 0;
+#endif
+
+    count_bytes(bytes + pos, limit - pos, 1, &state, &messageStruct);
+
+#if METRICS
+    add_chunk_metrics(&result->metrics, &messageStruct.metrics, &state, ch_value);
+#endif
+
+    result->num_words = messageStruct.num_words;
+    result->num_vowels = messageStruct.num_vowels;
+    result->num_cons = messageStruct.num_cons;
+    result->last_class = state.class_before | (state.value_before == 0 ? CLASS_ZERO : 0);
+}
@@ -4,10 +4,15 @@
  *  \brief Problem name: Total number of words, number of words beginning with a vowel and ending with a consonant.
  *
  *  Definition of the operations carried out by the workers:
+ *     \li char_class
  *     \li is_vowel
  *     \li is_consonant
  *     \li is_split
- *     \li processVal.
+ *     \li boundary_class
+ *     \li reset_state
+ *     \li processVal
+ *     \li processBytes
+ *     \li processChunk.
  * 
  *  \author Eduardo Santos and Pedro Bastos - May 2022
  */
@@ -18,9 +23,41 @@
 #ifndef WORKER
 #define WORKER
 
+/* Char class flags */
+
+/** \brief char is a vowel */
+#define CLASS_VOWEL        1
+
+/** \brief char is a consonant */
+#define CLASS_CONSONANT    2
+
+/** \brief char separates words */
+#define CLASS_SPLIT        4
+
+/** \brief char is an apostrophe, which only belongs to a word when it follows a non split char */
+#define CLASS_APOSTROPHE   8
+
+/** \brief char is 0, which never ends a word before it (kept only at chunk boundaries) */
+#define CLASS_ZERO         16
+
+/** \brief no char at a chunk boundary */
+#define CLASS_NONE         -1
+
+/** \brief Reset the state kept between chars */
+extern void reset_state(WordState *state);
+
 /** \brief Process each chunk */
 extern void processVal(MessageStruct * messageStruct);
 
+/** \brief Process a buffer of UTF-8 encoded text */
+extern int processBytes(const unsigned char *bytes, int n_bytes, int final, MessageStruct *messageStruct);
+
+/** \brief Process a chunk cut at any byte offset, keeping its boundary state */
+extern void processChunk(const unsigned char *bytes, int n_bytes, ChunkResult *result);
+
+/** \brief Get the class flags of a character */
+extern int char_class(int char_value);
+
 /** \brief Check if character is a vowel */
 extern int is_vowel(int char_value);
 
@@ -30,4 +67,7 @@ extern int is_consonant(int char_value);
 /** \brief Check if character is a split char */
 extern int is_split(int char_value);
 
+/** \brief Get the class of a character as kept at chunk boundaries */
+extern int boundary_class(int char_value);
+
 #endif
\ No newline at end of file
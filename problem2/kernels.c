@@ -0,0 +1,355 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_KERNELS 1
+#else
+#define X86_KERNELS 0
+#endif
+
+/* scalar kernels, the reference for the vectorized ones */
+
+static int pivotSearchScalar(const double *column, int length) {
+    int pivotRow = 0;
+
+    for (int row = 1; row < length; ++row) // only a larger value replaces the pivot, so the first one wins
+        if (fabs(column[row]) > fabs(column[pivotRow]))
+            pivotRow = row;
+
+    return pivotRow;
+}
+
+static void scaleScalar(double *x, double factor, int length) {
+    for (int i = 0; i < length; ++i)
+        x[i] *= factor;
+}
+
+static void subtractScaledScalar(double *target, const double *source, double factor, int length) {
+    for (int i = 0; i < length; ++i)
+        target[i] -= factor * source[i];
+}
+
+static void updateBlockScalar(int order, const double *lower, const double *upper, double *target, int depth) {
+    double sum[4][8] = { { 0.0 } };
+
+    for (int k = 0; k < depth; ++k)
+        for (int r = 0; r < 4; ++r)
+            for (int c = 0; c < 8; ++c)
+                sum[r][c] += lower[k * 4 + r] * upper[k * 8 + c];
+
+    for (int r = 0; r < 4; ++r)
+        for (int c = 0; c < 8; ++c)
+            target[(size_t)r * order + c] -= sum[r][c];
+}
+
+static const eliminationKernels scalarKernels = {
+    "scalar", 4, 8, pivotSearchScalar, scaleScalar, subtractScaledScalar, updateBlockScalar
+};
+
+#if X86_KERNELS
+
+/* SSE2 kernels, part of every x86-64 processor: 2 doubles per register */
+
+static int pivotSearchSse2(const double *column, int length) {
+    __m128d signBit = _mm_set1_pd(-0.0);
+    __m128d best = _mm_setzero_pd();
+    double lanes[2], largest;
+    int i = 0;
+
+    // largest absolute value, then the first element that has it
+    for (; i + 2 <= length; i += 2)
+        best = _mm_max_pd(best, _mm_andnot_pd(signBit, _mm_loadu_pd(column + i)));
+
+    _mm_storeu_pd(lanes, best);
+    largest = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    for (; i < length; ++i)
+        largest = fabs(column[i]) > largest ? fabs(column[i]) : largest;
+
+    __m128d target = _mm_set1_pd(largest);
+    for (i = 0; i + 2 <= length; i += 2) {
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_andnot_pd(signBit, _mm_loadu_pd(column + i)), target));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    for (; i < length; ++i)
+        if (fabs(column[i]) == largest)
+            return i;
+
+    return 0;
+}
+
+static void scaleSse2(double *x, double factor, int length) {
+    __m128d f = _mm_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 2 <= length; i += 2)
+        _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), f));
+    for (; i < length; ++i)
+        x[i] *= factor;
+}
+
+static void subtractScaledSse2(double *target, const double *source, double factor, int length) {
+    __m128d f = _mm_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 2 <= length; i += 2)
+        _mm_storeu_pd(target + i, _mm_sub_pd(_mm_loadu_pd(target + i), _mm_mul_pd(f, _mm_loadu_pd(source + i))));
+    for (; i < length; ++i)
+        target[i] -= factor * source[i];
+}
+
+// register block of 4 x 4: 8 sums, 2 elements of U and 1 multiplier in the 16 registers
+static void updateBlockSse2(int order, const double *lower, const double *upper, double *target, int depth) {
+    __m128d sum[4][2];
+
+    for (int r = 0; r < 4; ++r)
+        sum[r][0] = sum[r][1] = _mm_setzero_pd();
+
+    for (int k = 0; k < depth; ++k) {
+        __m128d u0 = _mm_loadu_pd(upper + k * 4);
+        __m128d u1 = _mm_loadu_pd(upper + k * 4 + 2);
+
+        for (int r = 0; r < 4; ++r) {
+            __m128d l = _mm_set1_pd(lower[k * 4 + r]);
+
+            sum[r][0] = _mm_add_pd(sum[r][0], _mm_mul_pd(l, u0));
+            sum[r][1] = _mm_add_pd(sum[r][1], _mm_mul_pd(l, u1));
+        }
+    }
+
+    for (int r = 0; r < 4; ++r) {
+        double *row = target + (size_t)r * order;
+
+        _mm_storeu_pd(row, _mm_sub_pd(_mm_loadu_pd(row), sum[r][0]));
+        _mm_storeu_pd(row + 2, _mm_sub_pd(_mm_loadu_pd(row + 2), sum[r][1]));
+    }
+}
+
+static const eliminationKernels sse2Kernels = {
+    "sse2", 4, 4, pivotSearchSse2, scaleSse2, subtractScaledSse2, updateBlockSse2
+};
+
+/* AVX2 kernels with fused multiply-add: 4 doubles per register */
+
+__attribute__((target("avx2,fma")))
+static int pivotSearchAvx2(const double *column, int length) {
+    __m256d signBit = _mm256_set1_pd(-0.0);
+    __m256d best = _mm256_setzero_pd();
+    double lanes[4], largest;
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        best = _mm256_max_pd(best, _mm256_andnot_pd(signBit, _mm256_loadu_pd(column + i)));
+
+    _mm256_storeu_pd(lanes, best);
+    largest = lanes[0];
+    for (int j = 1; j < 4; ++j)
+        largest = lanes[j] > largest ? lanes[j] : largest;
+    for (; i < length; ++i)
+        largest = fabs(column[i]) > largest ? fabs(column[i]) : largest;
+
+    __m256d target = _mm256_set1_pd(largest);
+    for (i = 0; i + 4 <= length; i += 4) {
+        __m256d value = _mm256_andnot_pd(signBit, _mm256_loadu_pd(column + i));
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(value, target, _CMP_EQ_OQ));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    for (; i < length; ++i)
+        if (fabs(column[i]) == largest)
+            return i;
+
+    return 0;
+}
+
+__attribute__((target("avx2,fma")))
+static void scaleAvx2(double *x, double factor, int length) {
+    __m256d f = _mm256_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+    for (; i < length; ++i)
+        x[i] *= factor;
+}
+
+__attribute__((target("avx2,fma")))
+static void subtractScaledAvx2(double *target, const double *source, double factor, int length) {
+    __m256d f = _mm256_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 4 <= length; i += 4)
+        _mm256_storeu_pd(target + i, _mm256_fnmadd_pd(f, _mm256_loadu_pd(source + i), _mm256_loadu_pd(target + i)));
+    for (; i < length; ++i)
+        target[i] = fma(-factor, source[i], target[i]);
+}
+
+// register block of 6 x 8: 12 sums, 2 elements of U and 1 multiplier in the 16 registers
+__attribute__((target("avx2,fma")))
+static void updateBlockAvx2(int order, const double *lower, const double *upper, double *target, int depth) {
+    __m256d sum[6][2];
+
+    for (int r = 0; r < 6; ++r)
+        sum[r][0] = sum[r][1] = _mm256_setzero_pd();
+
+    for (int k = 0; k < depth; ++k) {
+        __m256d u0 = _mm256_loadu_pd(upper + k * 8);
+        __m256d u1 = _mm256_loadu_pd(upper + k * 8 + 4);
+
+        for (int r = 0; r < 6; ++r) {
+            __m256d l = _mm256_broadcast_sd(lower + k * 6 + r);
+
+            sum[r][0] = _mm256_fmadd_pd(l, u0, sum[r][0]);
+            sum[r][1] = _mm256_fmadd_pd(l, u1, sum[r][1]);
+        }
+    }
+
+    for (int r = 0; r < 6; ++r) {
+        double *row = target + (size_t)r * order;
+
+        _mm256_storeu_pd(row, _mm256_sub_pd(_mm256_loadu_pd(row), sum[r][0]));
+        _mm256_storeu_pd(row + 4, _mm256_sub_pd(_mm256_loadu_pd(row + 4), sum[r][1]));
+    }
+}
+
+static const eliminationKernels avx2Kernels = {
+    "avx2", 6, 8, pivotSearchAvx2, scaleAvx2, subtractScaledAvx2, updateBlockAvx2
+};
+
+/* AVX-512 kernels: 8 doubles per register, masks for the last elements */
+
+__attribute__((target("avx512f")))
+static int pivotSearchAvx512(const double *column, int length) {
+    __m512d best = _mm512_setzero_pd();
+    double largest;
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        best = _mm512_max_pd(best, _mm512_abs_pd(_mm512_loadu_pd(column + i)));
+    if (i < length) {
+        __mmask8 tail = (__mmask8)((1u << (length - i)) - 1);
+        best = _mm512_max_pd(best, _mm512_abs_pd(_mm512_maskz_loadu_pd(tail, column + i)));
+    }
+    largest = _mm512_reduce_max_pd(best);
+
+    __m512d target = _mm512_set1_pd(largest);
+    for (i = 0; i < length; i += 8) {
+        __mmask8 valid = length - i >= 8 ? 0xFF : (__mmask8)((1u << (length - i)) - 1);
+        __mmask8 mask = _mm512_mask_cmp_pd_mask(valid, _mm512_abs_pd(_mm512_maskz_loadu_pd(valid, column + i)), target,
+                                                _CMP_EQ_OQ);
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    return 0;
+}
+
+__attribute__((target("avx512f")))
+static void scaleAvx512(double *x, double factor, int length) {
+    __m512d f = _mm512_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        _mm512_storeu_pd(x + i, _mm512_mul_pd(_mm512_loadu_pd(x + i), f));
+    if (i < length) {
+        __mmask8 tail = (__mmask8)((1u << (length - i)) - 1);
+        _mm512_mask_storeu_pd(x + i, tail, _mm512_mul_pd(_mm512_maskz_loadu_pd(tail, x + i), f));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void subtractScaledAvx512(double *target, const double *source, double factor, int length) {
+    __m512d f = _mm512_set1_pd(factor);
+    int i = 0;
+
+    for (; i + 8 <= length; i += 8)
+        _mm512_storeu_pd(target + i, _mm512_fnmadd_pd(f, _mm512_loadu_pd(source + i), _mm512_loadu_pd(target + i)));
+    if (i < length) {
+        __mmask8 tail = (__mmask8)((1u << (length - i)) - 1);
+        __m512d t = _mm512_maskz_loadu_pd(tail, target + i);
+
+        _mm512_mask_storeu_pd(target + i, tail, _mm512_fnmadd_pd(f, _mm512_maskz_loadu_pd(tail, source + i), t));
+    }
+}
+
+// register block of 8 x 16: 16 sums, 2 elements of U and 1 multiplier in the 32 registers
+__attribute__((target("avx512f")))
+static void updateBlockAvx512(int order, const double *lower, const double *upper, double *target, int depth) {
+    __m512d sum[8][2];
+
+    for (int r = 0; r < 8; ++r)
+        sum[r][0] = sum[r][1] = _mm512_setzero_pd();
+
+    for (int k = 0; k < depth; ++k) {
+        __m512d u0 = _mm512_loadu_pd(upper + k * 16);
+        __m512d u1 = _mm512_loadu_pd(upper + k * 16 + 8);
+
+        for (int r = 0; r < 8; ++r) {
+            __m512d l = _mm512_set1_pd(lower[k * 8 + r]);
+
+            sum[r][0] = _mm512_fmadd_pd(l, u0, sum[r][0]);
+            sum[r][1] = _mm512_fmadd_pd(l, u1, sum[r][1]);
+        }
+    }
+
+    for (int r = 0; r < 8; ++r) {
+        double *row = target + (size_t)r * order;
+
+        _mm512_storeu_pd(row, _mm512_sub_pd(_mm512_loadu_pd(row), sum[r][0]));
+        _mm512_storeu_pd(row + 8, _mm512_sub_pd(_mm512_loadu_pd(row + 8), sum[r][1]));
+    }
+}
+
+static const eliminationKernels avx512Kernels = {
+    "avx512", 8, 16, pivotSearchAvx512, scaleAvx512, subtractScaledAvx512, updateBlockAvx512
+};
+
+#endif
+
+const eliminationKernels *selectKernels(void) {
+    static const eliminationKernels *selected = NULL;
+
+    if (selected != NULL)
+        return selected;
+
+    const char *forced = getenv("DET_KERNELS");
+
+    selected = &scalarKernels;
+
+#if X86_KERNELS
+    __builtin_cpu_init();
+
+    int avx512 = __builtin_cpu_supports("avx512f");
+    int avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    int sse2 = __builtin_cpu_supports("sse2");
+
+    if (forced != NULL) { // kernels asked for, if the processor has them
+        if (strcmp(forced, "avx512") == 0 && avx512)
+            selected = &avx512Kernels;
+        else if (strcmp(forced, "avx2") == 0 && avx2)
+            selected = &avx2Kernels;
+        else if (strcmp(forced, "sse2") == 0 && sse2)
+            selected = &sse2Kernels;
+        else if (strcmp(forced, "scalar") != 0)
+            fprintf(stderr, "DET_KERNELS=%s is not supported, using the scalar kernels\n", forced);
+    }
+    else if (avx512)
+        selected = &avx512Kernels;
+    else if (avx2)
+        selected = &avx2Kernels;
+    else if (sse2)
+        selected = &sse2Kernels;
+#else
+    if (forced != NULL && strcmp(forced, "scalar") != 0)
+        fprintf(stderr, "DET_KERNELS=%s is not supported, using the scalar kernels\n", forced);
+#endif
+
+    return selected;
+}
@@ -0,0 +1,45 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+#include <stdio.h>
+
+/**
+ * \file kernels.h
+ *
+ * @brief Kernels of the elimination, scalar or vectorized for an instruction set, and the method to choose them
+ *
+ * \author Eduardo Santos and Pedro Bastos - May 2022
+ */
+
+/**
+ * @brief Kernels of the elimination for one instruction set
+ */
+typedef struct eliminationKernels {
+    const char *name;
+    int rows; // rows of the register block of updateBlock
+    int cols; // columns of the register block of updateBlock
+
+    // index of the first element with the largest absolute value
+    int (*pivotSearch)(const double *column, int length);
+
+    // x[i] *= factor
+    void (*scale)(double *x, double factor, int length);
+
+    // target[i] -= factor * source[i]
+    void (*subtractScaled)(double *target, const double *source, double factor, int length);
+
+    // subtract the product of a packed block of L, "rows" multipliers per step, and a packed block of U, "cols"
+    // elements per step, from a register block of the matrix
+    void (*updateBlock)(int order, const double *lower, const double *upper, double *target, int depth);
+} eliminationKernels;
+
+/**
+ * @brief Method to choose the kernels, once, for the instruction sets of the processor
+ *
+ * The fastest kernels the CPU supports are chosen with CPUID, unless the DET_KERNELS environment variable
+ * names other ones: scalar (the reference), sse2, avx2 or avx512.
+ *
+ * @return eliminationKernels* the kernels to be used
+ */
+const eliminationKernels *selectKernels(void);
+
+#endif
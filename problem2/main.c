@@ -11,6 +11,7 @@
 #include <math.h>
 #include "worker.h"
 #include "dispatcher.h"
+#include "kernels.h"
 
 /* General definitions */
 #define WORKTODO 1
@@ -50,6 +51,8 @@ int main(int argc, char *argv[]) {
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    selectKernels(); // choose the kernels of the elimination for this processor, once
+
     nWorkers = size - 1;
 
     if (rank == 0) { // root process (dispatcher)
@@ -1,49 +1,197 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "worker.h"
+#include "kernels.h"
+
+/**
+ * @brief Factorize a panel stored by columns, with partial pivoting
+ *
+ * The panel holds the rows from the diagonal down, so the pivot search runs along a contiguous column.
+ * Each pivot row is scaled by the reciprocal of its pivot, computed once, instead of dividing every element.
+ *
+ * @param panel the columns of the panel, "rows" elements each, replaced by their L and U factors
+ * @param rows number of rows of the panel
+ * @param cols number of columns of the panel
+ * @param pivots row swapped with each row of the panel, relative to the first one
+ * @param det the determinant, updated with the pivots and the row swaps
+ * @param kernels kernels of the elimination
+ * @return int 0 if a pivot is zero, 1 otherwise
+ */
+static int factorizePanel(double *panel, int rows, int cols, int *pivots, double *det, const eliminationKernels *kernels) {
+    for (int j = 0; j < cols; ++j) {
+        double *column = panel + (size_t)j * rows;
+
+        // partial pivoting, the first entry with the largest absolute value wins as in the textbook elimination
+        int pivotRow = j + kernels->pivotSearch(column + j, rows - j);
+
+        pivots[j] = pivotRow;
+
+        // if the diagonal element is zero then the determinant will be zero
+        if (column[pivotRow] == 0.0)
+            return 0;
+
+        if (pivotRow != j) { // swap the rows inside the panel, the rest of the matrix is swapped afterwards
+            for (int k = 0; k < cols; k++) {
+                double temp = panel[(size_t)k * rows + j];
+
+                panel[(size_t)k * rows + j] = panel[(size_t)k * rows + pivotRow];
+                panel[(size_t)k * rows + pivotRow] = temp;
+            }
+
+            *det *= -1.0; //signal the row swapping
+        }
+
+        *det *= column[j]; //update the determinant with the the diagonal value of the current row
+
+        double reciprocal = 1.0 / column[j];
+
+        kernels->scale(column + j + 1, reciprocal, rows - j - 1); // multipliers of the rows below the pivot
+
+        for (int k = j + 1; k < cols; ++k) { // reduce the columns of the panel on the right
+            double *target = panel + (size_t)k * rows;
+
+            kernels->subtractScaled(target + j + 1, column + j + 1, target[j], rows - j - 1);
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Subtract the product of a row of L and a block of U from a row of the matrix, for the edges of the tiles
+ *
+ * @param order Matrix order
+ * @param lower first multiplier of the row of L
+ * @param upper first element of the block of U
+ * @param target first element of the row
+ * @param depth number of columns of L and rows of U
+ * @param width number of columns of the row
+ * @param kernels kernels of the elimination
+ */
+static void updateRow(int order, const double *lower, const double *upper, double *target, int depth, int width,
+                      const eliminationKernels *kernels) {
+    for (int k = 0; k < depth; ++k)
+        kernels->subtractScaled(target, upper + (size_t)k * order, lower[k], width);
+}
+
+/**
+ * @brief Update the trailing matrix, A22 -= L21 * U12, by tiles of LU_TILE columns
+ *
+ * L21 is packed once by blocks of kernels->rows rows, and U12 once per tile by blocks of kernels->cols columns,
+ * so the register blocks read both with unit stride. The rows and columns left over are updated row by row.
+ *
+ * @param order Matrix order
+ * @param matrix the matrix
+ * @param start first row and column of the trailing matrix
+ * @param depth number of columns of the panel
+ * @param packedLower buffer for L21, (order - start) * depth elements
+ * @param packedUpper buffer for a tile of U12, LU_TILE * depth elements
+ * @param kernels kernels of the elimination
+ */
+static void updateTrailing(int order, double *matrix, int start, int depth, double *packedLower, double *packedUpper,
+                           const eliminationKernels *kernels) {
+    int blockRows = kernels->rows, blockCols = kernels->cols;
+    int first = start - depth; // first column of the panel, and first row of U12
+    int rowsEnd = start + (order - start) / blockRows * blockRows;
+
+    for (int row = start; row < rowsEnd; row += blockRows)
+        for (int k = 0; k < depth; ++k)
+            for (int r = 0; r < blockRows; ++r)
+                packedLower[(size_t)(row - start) * depth + k * blockRows + r] = matrix[(size_t)(row + r) * order + first + k];
+
+    for (int tile = start; tile < order; tile += LU_TILE) {
+        int tileEnd = tile + LU_TILE < order ? tile + LU_TILE : order;
+        int colsEnd = tile + (tileEnd - tile) / blockCols * blockCols;
+        const double *upper = matrix + (size_t)first * order + tile;
+
+        for (int col = tile; col < colsEnd; col += blockCols)
+            for (int k = 0; k < depth; ++k)
+                for (int c = 0; c < blockCols; ++c)
+                    packedUpper[(size_t)(col - tile) * depth + k * blockCols + c] = upper[(size_t)k * order + col - tile + c];
+
+        for (int row = start; row < rowsEnd; row += blockRows)
+            for (int col = tile; col < colsEnd; col += blockCols)
+                kernels->updateBlock(order, packedLower + (size_t)(row - start) * depth,
+                                     packedUpper + (size_t)(col - tile) * depth, matrix + (size_t)row * order + col, depth);
+
+        for (int row = start; row < rowsEnd && colsEnd < tileEnd; ++row) // columns left over
+            updateRow(order, matrix + (size_t)row * order + first, upper + (colsEnd - tile),
+                      matrix + (size_t)row * order + colsEnd, depth, tileEnd - colsEnd, kernels);
+
+        for (int row = rowsEnd; row < order; ++row) // rows left over
+            updateRow(order, matrix + (size_t)row * order + first, upper, matrix + (size_t)row * order + tile, depth,
+                      tileEnd - tile, kernels);
+    }
+}
 
 double computeDeterminant(int order,  double * matrix) {
+    const eliminationKernels *kernels = selectKernels();
     double det = 1;
-    double pivotElement;
-    int pivotRow;
-
-    for (int i = 0; i < order; ++i) {
-        pivotElement = matrix[ (i * order) + i]; // current diagonal element
-        pivotRow = i;
-        // partial pivoting, which should select
-        // the entry with largest absolute value from the column of the matrix
-        // that is currently being considered as the pivot element
-        for (int row = i + 1; row < order; ++row) {
-            if (fabs(matrix[(row * order) + i]) > fabs(pivotElement)) {
-                // update the value of the pivot and pivot row index
-                pivotElement = matrix[(row * order) + i];
-                pivotRow = row;
-            }
+    int blockSize = LU_BLOCK < order ? LU_BLOCK : order;
+    double *panel = malloc(sizeof(double) * order * blockSize);
+    int *pivots = malloc(sizeof(int) * blockSize);
+    int trailing = order - blockSize > 0 ? order - blockSize : 1; // largest trailing matrix
+    double *packedLower = malloc(sizeof(double) * trailing * blockSize);
+    double *packedUpper = malloc(sizeof(double) * (trailing < LU_TILE ? trailing : LU_TILE) * blockSize);
+
+    // right-looking blocked LU: factorize a panel of columns, then update the rest of the matrix with it
+    for (int first = 0; first < order; first += blockSize) {
+        int cols = order - first < blockSize ? order - first : blockSize;
+        int rows = order - first;
+        int start = first + cols; // first row and column after the panel
+
+        // copy the panel by columns, from the diagonal down
+        for (int row = 0; row < rows; ++row)
+            for (int k = 0; k < cols; ++k)
+                panel[(size_t)k * rows + row] = matrix[(size_t)(first + row) * order + first + k];
+
+        if (!factorizePanel(panel, rows, cols, pivots, &det, kernels)) {
+            det = 0.0;
+            break;
         }
-        //i f the diagonal element is zero then the determinant will be zero
-        if (pivotElement == 0.0)
-            return 0.0;
 
-        if (pivotRow != i) { // if the pivotELement is not in the current row, then we perform a swap in the columns
-            for (int k = 0; k < order; k++) {
-                double temp;
-                temp = matrix[(i * order) + k];
+        // copy back the factors, the columns on the left are no longer needed for the determinant
+        for (int row = 0; row < rows; ++row)
+            for (int k = 0; k < cols; ++k)
+                matrix[(size_t)(first + row) * order + first + k] = panel[(size_t)k * rows + row];
 
-                matrix[(i * order) + k] = matrix[(pivotRow * order) + k];
-                matrix[(pivotRow * order) + k] = temp;
-            }
+        if (start == order)
+            break;
+
+        // apply the row swaps of the panel to the columns on the right
+        for (int j = 0; j < cols; ++j) {
+            if (pivots[j] != j) {
+                double *rowA = matrix + (size_t)(first + j) * order;
+                double *rowB = matrix + (size_t)(first + pivots[j]) * order;
 
-            det *= -1.0; //signal the row swapping
+                for (int k = start; k < order; k++) {
+                    double temp = rowA[k];
+
+                    rowA[k] = rowB[k];
+                    rowB[k] = temp;
+                }
+            }
         }
 
-        det *= pivotElement; //update the determinant with the the diagonal value of the current row
+        // U12 = L11^-1 * A12, with the unit lower triangle of the panel
+        for (int j = 0; j < cols; ++j) {
+            const double *pivotRow = matrix + (size_t)(first + j) * order;
 
-        for (int row = i + 1; row < order; ++row) { /* reduce the matrix to a  Upper Triangle Matrix */
-        // as the current row and column "i" will no longer be used, we may start reducing on the next row/column (i+1)
-            for (int col = i + 1; col < order; ++col)
-                matrix[(row * order) + col] -= matrix[(row * order) + i] * matrix[(i * order) + col] / pivotElement;  //reduce the value
+            for (int row = j + 1; row < cols; ++row) {
+                double *target = matrix + (size_t)(first + row) * order;
+
+                kernels->subtractScaled(target + start, pivotRow + start, target[first + j], order - start);
+            }
         }
+
+        updateTrailing(order, matrix, start, cols, packedLower, packedUpper, kernels);
     }
 
+    free(panel);
+    free(pivots);
+    free(packedLower);
+    free(packedUpper);
+
     return det;
-}
\ No newline at end of file
+}
@@ -14,4 +14,18 @@
  * @return double the determinant value
  */
 double computeDeterminant(int order, double *matrix);
-#endif
\ No newline at end of file
+
+/**
+ * @brief Number of columns of the panels of the blocked LU, tunable at compile time with -DLU_BLOCK=
+ */
+#ifndef LU_BLOCK
+#define LU_BLOCK 16
+#endif
+
+/**
+ * @brief Number of columns of the tiles of the trailing update, tunable at compile time with -DLU_TILE=
+ */
+#ifndef LU_TILE
+#define LU_TILE 256
+#endif
+#endif